@@ -0,0 +1,29 @@
+#include "alloc_count.h"
+#include <cstdlib>
+#include <new>
+
+#if FIETS_COUNT_ALLOCATIONS
+static thread_local size_t allocations = 0;
+
+size_t allocation_count() {
+  return allocations;
+}
+
+void* operator new(size_t size) {
+  allocations++;
+  if (void* p = malloc(size ? size : 1)) return p;
+  throw std::bad_alloc();
+}
+
+void operator delete(void* p) noexcept {
+  free(p);
+}
+
+void operator delete(void* p, size_t) noexcept {
+  free(p);
+}
+#else
+size_t allocation_count() {
+  return 0;
+}
+#endif
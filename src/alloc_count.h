@@ -0,0 +1,19 @@
+#pragma once
+
+#include <cstddef>
+
+// Replacing operator new costs every allocation and hides ASan's own new/delete checks, so heap
+// allocations are only counted in builds with FIETS_COUNT_ALLOCATIONS=1, which FIETS_STATS implies.
+#if FIETS_STATS && !defined(FIETS_COUNT_ALLOCATIONS)
+#define FIETS_COUNT_ALLOCATIONS 1
+#endif
+
+#if FIETS_COUNT_ALLOCATIONS
+constexpr bool counting_allocations = true;
+#else
+constexpr bool counting_allocations = false;
+#endif
+
+// Number of heap allocations the calling thread has made so far, counted by the replacement
+// global operator new in alloc_count.cpp; always 0 when allocations are not counted.
+size_t allocation_count();
@@ -0,0 +1,31 @@
+#include "arena.h"
+#include <algorithm>
+#include <cstdint>
+
+void* Arena::allocate(size_t size, size_t align) {
+  allocations++;
+  char* p = reinterpret_cast<char*>((reinterpret_cast<uintptr_t>(pos) + align - 1) & ~uintptr_t(align - 1));
+  if (!pos || size > size_t(end - p)) {
+    // Oversized requests get a block of their own, so the current block can still be filled up.
+    size_t blockSize = std::max(nextBlockSize, size + align);
+    storage.emplace_back(new char[blockSize]);
+    char* block = storage.back().get();
+    p = reinterpret_cast<char*>((reinterpret_cast<uintptr_t>(block) + align - 1) & ~uintptr_t(align - 1));
+    if (blockSize > nextBlockSize) return p;
+    end = block + blockSize;
+    nextBlockSize = std::min<size_t>(nextBlockSize * 2, 1 << 20);
+  }
+  pos = p + size;
+  return p;
+}
+
+void Arena::adopt(std::unique_ptr<Arena> child) {
+  allocations += child->allocations;
+  children.push_back(std::move(child));
+}
+
+size_t Arena::blocks() const {
+  size_t count = storage.size();
+  for (auto& child : children) count += child->blocks();
+  return count;
+}
@@ -0,0 +1,53 @@
+#pragma once
+
+#include <cstddef>
+#include <memory>
+#include <type_traits>
+#include <vector>
+
+// Monotonic allocator: hands out memory from a few large blocks and releases it all at once
+// when the arena is destroyed. Individual deallocations are no-ops.
+struct Arena {
+  Arena() = default;
+  Arena(const Arena&) = delete;
+  Arena& operator=(const Arena&) = delete;
+  void* allocate(size_t size, size_t align);
+  // Keeps child alive as long as this arena, for trees built in one arena and moved into another's.
+  void adopt(std::unique_ptr<Arena> child);
+  // Number of allocate() calls served, and number of heap blocks they were carved from.
+  size_t allocations = 0;
+  size_t blocks() const;
+private:
+  std::vector<std::unique_ptr<char[]>> storage;
+  std::vector<std::unique_ptr<Arena>> children;
+  char* pos = nullptr;
+  char* end = nullptr;
+  size_t nextBlockSize = 16384;
+};
+
+// Allocates from an Arena, or from the heap when default constructed.
+template <typename T>
+struct ArenaAllocator {
+  using value_type = T;
+  using propagate_on_container_move_assignment = std::true_type;
+  using propagate_on_container_swap = std::true_type;
+  Arena* arena = nullptr;
+  ArenaAllocator() = default;
+  ArenaAllocator(Arena* arena) : arena(arena) {}
+  template <typename U>
+  ArenaAllocator(const ArenaAllocator<U>& other) : arena(other.arena) {}
+  T* allocate(size_t n) {
+    if (!arena) return std::allocator<T>().allocate(n);
+    return static_cast<T*>(arena->allocate(n * sizeof(T), alignof(T)));
+  }
+  void deallocate(T* p, size_t n) {
+    if (!arena) std::allocator<T>().deallocate(p, n);
+  }
+  template <typename U>
+  bool operator==(const ArenaAllocator<U>& other) const { return arena == other.arena; }
+  template <typename U>
+  bool operator!=(const ArenaAllocator<U>& other) const { return arena != other.arena; }
+};
+
+template <typename T>
+using ArenaVector = std::vector<T, ArenaAllocator<T>>;
@@ -0,0 +1,262 @@
+#include "ast_file.h"
+#include "sink.h"
+
+static constexpr std::string_view magic = "FIETSAST";
+
+// The encoding numbers entries and text parts by their variant index.
+static_assert(std::is_same_v<std::variant_alternative_t<0, DocumentEntry>, Code> &&
+              std::is_same_v<std::variant_alternative_t<8, DocumentEntry>, Quote> &&
+              std::variant_size_v<DocumentEntry> == 9, "update Writer and Reader for the new DocumentEntry");
+static_assert(std::variant_size_v<decltype(Text::seq)::value_type> == 6, "update Writer and Reader for the new Text part");
+
+namespace {
+
+struct Writer {
+  std::string blob, tree;
+  void number(uint64_t value) {
+    while (value >= 0x80) {
+      tree += char(value | 0x80);
+      value >>= 7;
+    }
+    tree += char(value);
+  }
+  void string(std::string_view s) {
+    number(blob.size());
+    number(s.size());
+    blob += s;
+  }
+  void text(const Text& text) {
+    number(text.seq.size());
+    for (auto& part : text.seq) {
+      number(part.index());
+      if (auto* s = std::get_if<std::string_view>(&part)) string(*s);
+      else if (auto* i = std::get_if<Insertion>(&part)) this->text(i->text);
+      else if (auto* d = std::get_if<Deletion>(&part)) this->text(d->text);
+      else if (auto* r = std::get_if<Reference>(&part)) number(r->index);
+      else if (auto* id = std::get_if<Identifier>(&part)) string(id->text);
+      else if (auto* c = std::get_if<CodeSpan>(&part)) string(c->text);
+    }
+  }
+  void texts(const ArenaVector<Text>& texts) {
+    number(texts.size());
+    for (auto& t : texts) text(t);
+  }
+  // The chapter's entries and subchapters; its level, title and hash are written by the caller.
+  void chapter(const Chapter& ch) {
+    number(ch.entries.size());
+    for (auto& entry : ch.entries) {
+      number(entry.index());
+      if (auto* code = std::get_if<Code>(&entry)) {
+        string(code->language);
+        string(code->body);
+      } else if (auto* list = std::get_if<List>(&entry)) {
+        texts(list->entries);
+      } else if (auto* list = std::get_if<OrderedList>(&entry)) {
+        texts(list->entries);
+      } else if (auto* def = std::get_if<IdentifierDefinition>(&entry)) {
+        string(def->identifier);
+        text(def->definition);
+      } else if (auto* table = std::get_if<Table>(&entry)) {
+        number(table->entries.size());
+        for (auto& row : table->entries) texts(row);
+      } else if (auto* t = std::get_if<Text>(&entry)) {
+        text(*t);
+      } else if (auto* quote = std::get_if<Quote>(&entry)) {
+        texts(quote->texts);
+      }
+    }
+    number(ch.subchapters.size());
+    for (auto& sub : ch.subchapters) {
+      number(sub.level);
+      string(sub.title);
+      number(sub.contentHash);
+      chapter(sub);
+    }
+  }
+};
+
+// Reads the tree back. Any read past the end or out of the blob sets failed and yields zeroes,
+// so a damaged file gives up quickly instead of building a huge tree. Nesting is bounded so that
+// one cannot exhaust the stack either.
+struct Reader {
+  std::string_view blob, tree;
+  Document& doc;
+  size_t pos = 0;
+  bool failed = false;
+  size_t depth = 0;
+  static constexpr size_t maxDepth = 1000;
+  uint64_t number() {
+    uint64_t value = 0;
+    for (int shift = 0; shift < 64; shift += 7) {
+      if (pos == tree.size()) break;
+      uint8_t byte = tree[pos++];
+      value |= uint64_t(byte & 0x7F) << shift;
+      if (!(byte & 0x80)) return value;
+    }
+    failed = true;
+    return 0;
+  }
+  // A count of items that each take at least one byte; anything larger than what is left is damage.
+  size_t count() {
+    uint64_t n = number();
+    if (n > tree.size() - pos) failed = true;
+    return failed ? 0 : n;
+  }
+  std::string_view string() {
+    uint64_t offset = number(), size = number();
+    if (offset > blob.size() || size > blob.size() - offset) failed = true;
+    return failed ? std::string_view() : blob.substr(offset, size);
+  }
+  Text text() {
+    Text text(doc.arena.get());
+    if (++depth > maxDepth) failed = true;
+    size_t parts = count();
+    text.seq.reserve(parts);
+    for (size_t n = 0; n < parts && !failed; n++) {
+      switch(number()) {
+      case 0: text.seq.push_back(string()); break;
+      case 1: text.seq.push_back(Insertion{this->text()}); break;
+      case 2: text.seq.push_back(Deletion{this->text()}); break;
+      case 3: {
+        uint64_t index = number();
+        if (index == 0 || index > doc.references.size()) failed = true;
+        text.seq.push_back(Reference{uint32_t(index)});
+        break;
+      }
+      case 4: text.seq.push_back(Identifier{string()}); break;
+      case 5: text.seq.push_back(CodeSpan{string()}); break;
+      default: failed = true;
+      }
+    }
+    depth--;
+    return text;
+  }
+  void texts(ArenaVector<Text>& texts) {
+    size_t n = count();
+    texts.reserve(n);
+    while (n-- && !failed) texts.push_back(text());
+  }
+  void chapter(Chapter& ch) {
+    if (++depth > maxDepth) failed = true;
+    size_t entries = count();
+    ch.entries.reserve(entries);
+    for (size_t n = 0; n < entries && !failed; n++) {
+      switch(number()) {
+      case 0: {
+        std::string_view language = string();
+        ch.entries.push_back(Code{language, string()});
+        break;
+      }
+      case 1: {
+        List list(doc.arena.get());
+        texts(list.entries);
+        ch.entries.push_back(std::move(list));
+        break;
+      }
+      case 2: {
+        OrderedList list(doc.arena.get());
+        texts(list.entries);
+        ch.entries.push_back(std::move(list));
+        break;
+      }
+      case 3: {
+        std::string_view identifier = string();
+        ch.entries.push_back(IdentifierDefinition{identifier, text()});
+        break;
+      }
+      case 4: {
+        Table table(doc.arena.get());
+        size_t rows = count();
+        table.entries.reserve(rows);
+        while (rows-- && !failed) texts(table.entries.emplace_back(doc.arena.get()));
+        ch.entries.push_back(std::move(table));
+        break;
+      }
+      case 5: ch.entries.push_back(text()); break;
+      case 6: ch.entries.push_back(References()); break;
+      case 7: ch.entries.push_back(TOC()); break;
+      case 8: {
+        Quote quote(doc.arena.get());
+        texts(quote.texts);
+        ch.entries.push_back(std::move(quote));
+        break;
+      }
+      default: failed = true;
+      }
+    }
+    size_t subchapters = count();
+    ch.subchapters.reserve(subchapters);
+    for (size_t n = 0; n < subchapters && !failed; n++) {
+      int level = int(number());
+      std::string_view title = string();
+      Chapter& sub = ch.subchapters.emplace_back(doc.arena.get(), level, title);
+      sub.contentHash = number();
+      chapter(sub);
+    }
+    depth--;
+  }
+};
+
+void put32(std::string& out, uint32_t value) {
+  for (int n = 0; n < 4; n++) out += char(value >> (8 * n));
+}
+
+void put64(std::string& out, uint64_t value) {
+  for (int n = 0; n < 8; n++) out += char(value >> (8 * n));
+}
+
+uint64_t get(std::string_view in, size_t offset, size_t size) {
+  uint64_t value = 0;
+  for (size_t n = 0; n < size; n++) value |= uint64_t((unsigned char)in[offset + n]) << (8 * n);
+  return value;
+}
+
+}
+
+bool save(const Document& doc, const std::filesystem::path& path) {
+  Writer w;
+  w.string(doc.subtitle);
+  w.number(doc.references.size());
+  for (auto& r : doc.references) {
+    w.string(r.url);
+    w.string(r.name);
+  }
+  w.number(doc.level);
+  w.string(doc.title);
+  w.number(doc.contentHash);
+  w.chapter(doc);
+
+  std::string header(magic);
+  put32(header, ast_format_version);
+  put32(header, 0);
+  put64(header, w.blob.size());
+  FileSink out(path);
+  out << header << w.blob << w.tree;
+  return out.close();
+}
+
+std::optional<Document> load(const std::filesystem::path& path) {
+  std::unique_ptr<MappedFile> file = MappedFile::open(path);
+  if (!file) return std::nullopt;
+  std::string_view data = file->data();
+  constexpr size_t headerSize = magic.size() + 16;
+  if (data.size() < headerSize || !data.starts_with(magic) || get(data, 8, 4) != ast_format_version) return std::nullopt;
+  uint64_t blobSize = get(data, 16, 8);
+  if (blobSize > data.size() - headerSize) return std::nullopt;
+
+  Document doc;
+  Reader r{data.substr(headerSize, blobSize), data.substr(headerSize + blobSize), doc};
+  doc.subtitle = r.string();
+  size_t references = r.count();
+  for (size_t n = 0; n < references && !r.failed; n++) {
+    std::string_view url = r.string();
+    doc.addReference(url, r.string());
+  }
+  doc.level = int(r.number());
+  doc.title = r.string();
+  doc.contentHash = r.number();
+  r.chapter(doc);
+  if (r.failed || r.pos != r.tree.size()) return std::nullopt;
+  doc.source = std::move(file);
+  return doc;
+}
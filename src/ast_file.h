@@ -0,0 +1,19 @@
+#pragma once
+
+#include "parser.h"
+#include <filesystem>
+#include <optional>
+
+// Binary form of a parsed Document, for reusing a parse without the source and for handing the
+// tree to other tools. The file starts with "FIETSAST", a format version and the size of a blob
+// holding every string in the tree; the tree follows as varints, with strings as (offset, length)
+// into the blob. Loading maps the file and points the tree's strings into the mapping, so no
+// text is copied or re-lexed.
+
+// Increase whenever the encoding or the meaning of the tree changes.
+constexpr uint32_t ast_format_version = 1;
+
+// Returns false if the file cannot be written.
+bool save(const Document& doc, const std::filesystem::path& path);
+// Returns nothing if the file cannot be read, is not an AST file, has another format version or is damaged.
+std::optional<Document> load(const std::filesystem::path& path);
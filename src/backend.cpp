@@ -0,0 +1,157 @@
+#include "backend.h"
+#include "stats.h"
+
+namespace {
+
+struct Walker {
+  const Document& doc;
+  // The backends that receive the current events.
+  std::vector<Backend*> active;
+
+  template <typename F>
+  void each(F&& f) {
+    for (Backend* b : active) f(*b);
+  }
+
+#if FIETS_STATS
+  size_t written() const {
+    size_t n = 0;
+    for (Backend* b : active) n += b->written();
+    return n;
+  }
+#endif
+
+  void text(const Text& text) {
+    for (auto& part : text.seq) {
+      if (auto* s = std::get_if<std::string_view>(&part)) {
+        each([&](Backend& b) { b.text(*s); });
+      } else if (auto* i = std::get_if<Insertion>(&part)) {
+        each([](Backend& b) { b.beginInsertion(); });
+        this->text(i->text);
+        each([](Backend& b) { b.endInsertion(); });
+      } else if (auto* d = std::get_if<Deletion>(&part)) {
+        each([](Backend& b) { b.beginDeletion(); });
+        this->text(d->text);
+        each([](Backend& b) { b.endDeletion(); });
+      } else if (auto* r = std::get_if<Reference>(&part)) {
+        each([&](Backend& b) { b.reference(doc.references[r->index - 1]); });
+      } else if (auto* id = std::get_if<Identifier>(&part)) {
+        each([&](Backend& b) { b.identifier(id->text); });
+      } else if (auto* c = std::get_if<CodeSpan>(&part)) {
+        each([&](Backend& b) { b.codeSpan(c->text); });
+      }
+    }
+  }
+
+  void list(const ArenaVector<Text>& items, bool ordered) {
+    each([&](Backend& b) { b.beginList(ordered); });
+    for (auto& item : items) {
+      each([](Backend& b) { b.beginListItem(); });
+      text(item);
+      each([](Backend& b) { b.endListItem(); });
+    }
+    each([&](Backend& b) { b.endList(ordered); });
+  }
+
+  static bool is_separator(const ArenaVector<Text>& row) {
+    for (auto& cell : row) {
+      if (cell.seq.size() != 1 || !std::holds_alternative<std::string_view>(cell.seq[0]) || std::get<std::string_view>(cell.seq[0]) != "-") return false;
+    }
+    return true;
+  }
+
+  void row(const ArenaVector<Text>& cells, bool header) {
+    each([&](Backend& b) { b.beginRow(header); });
+    for (auto& cell : cells) {
+      each([&](Backend& b) { b.beginCell(header); });
+      text(cell);
+      each([&](Backend& b) { b.endCell(header); });
+    }
+    each([&](Backend& b) { b.endRow(header); });
+  }
+
+  void table(const Table& table) {
+    bool header = table.entries.size() >= 3 && is_separator(table.entries[1]);
+    each([](Backend& b) { b.beginTable(); });
+    size_t n = 0;
+    if (header) {
+      row(table.entries[0], true);
+      n = 2;
+    }
+    for (; n < table.entries.size(); n++) row(table.entries[n], false);
+    each([](Backend& b) { b.endTable(); });
+  }
+
+  void entry(const DocumentEntry& entry) {
+#if FIETS_STATS
+    // The phases from Code on follow the order of DocumentEntry's alternatives.
+    static_assert(size_t(Phase::Quote) - size_t(Phase::Code) + 1 == std::variant_size_v<DocumentEntry>);
+    StatsScope scope(Phase(size_t(Phase::Code) + entry.index()));
+    size_t before = written();
+#endif
+    if (auto* t = std::get_if<Text>(&entry)) {
+      each([](Backend& b) { b.beginParagraph(); });
+      text(*t);
+      each([](Backend& b) { b.endParagraph(); });
+    } else if (auto* c = std::get_if<Code>(&entry)) {
+      each([&](Backend& b) { b.code(*c); });
+    } else if (auto* l = std::get_if<List>(&entry)) {
+      list(l->entries, false);
+    } else if (auto* l = std::get_if<OrderedList>(&entry)) {
+      list(l->entries, true);
+    } else if (auto* q = std::get_if<Quote>(&entry)) {
+      each([](Backend& b) { b.beginQuote(); });
+      for (auto& line : q->texts) {
+        each([](Backend& b) { b.beginQuoteLine(); });
+        text(line);
+        each([](Backend& b) { b.endQuoteLine(); });
+      }
+      each([](Backend& b) { b.endQuote(); });
+    } else if (auto* t = std::get_if<Table>(&entry)) {
+      table(*t);
+    } else if (auto* d = std::get_if<IdentifierDefinition>(&entry)) {
+      std::vector<Backend*> outer = active;
+      std::erase_if(active, [&](Backend* b) { return !b->beginDefinition(d->identifier); });
+      text(d->definition);
+      active = std::move(outer);
+      each([](Backend& b) { b.endDefinition(); });
+    } else if (std::holds_alternative<TOC>(entry)) {
+      each([](Backend& b) { b.toc(); });
+    } else if (std::holds_alternative<References>(entry)) {
+      each([](Backend& b) { b.references(); });
+    }
+#if FIETS_STATS
+    scope.bytes = written() - before;
+#endif
+  }
+
+  // Walks the chapter at outline[index] and its subchapters, which follow it in the outline.
+  size_t chapter(const std::vector<OutlineEntry>& outline, size_t index) {
+    const OutlineEntry& ch = outline[index++];
+    std::vector<Backend*> outer = active;
+    std::erase_if(active, [&](Backend* b) { return !b->beginChapter(ch); });
+    for (auto& e : ch.chapter->entries) entry(e);
+    active = std::move(outer);
+    each([&](Backend& b) { b.endChapter(ch); });
+    for (size_t n = 0; n < ch.chapter->subchapters.size(); n++) index = chapter(outline, index);
+    return index;
+  }
+};
+
+}
+
+void render(const Document& doc, const std::vector<Backend*>& backends) {
+  Walker walker{doc, backends};
+#if FIETS_STATS
+  StatsScope scope(Phase::Render);
+  size_t before = walker.written();
+#endif
+  std::vector<OutlineEntry> outline = resolve(doc);
+  walker.each([&](Backend& b) { b.beginDocument(doc, outline); });
+  for (auto& e : doc.entries) walker.entry(e);
+  for (size_t index = 0; index < outline.size(); ) index = walker.chapter(outline, index);
+  walker.each([](Backend& b) { b.endDocument(); });
+#if FIETS_STATS
+  scope.bytes = walker.written() - before;
+#endif
+}
@@ -0,0 +1,59 @@
+#pragma once
+
+#include "parser.h"
+#include "outline.h"
+#include <string_view>
+#include <vector>
+
+// An output format. render() walks a Document once and reports it to each backend as a stream of
+// events in document order; every event does nothing by default, so a backend only overrides
+// what it writes.
+struct Backend {
+  virtual ~Backend() = default;
+  // Bytes of output so far, for --stats.
+  virtual size_t written() const { return 0; }
+
+  virtual void beginDocument(const Document&, const std::vector<OutlineEntry>&) {}
+  virtual void endDocument() {}
+  // Returning false skips the events for the chapter's own entries (for instance when its output
+  // is cached); endChapter still follows, and so do the subchapters.
+  virtual bool beginChapter(const OutlineEntry&) { return true; }
+  virtual void endChapter(const OutlineEntry&) {}
+
+  virtual void beginParagraph() {}
+  virtual void endParagraph() {}
+  virtual void beginList(bool /*ordered*/) {}
+  virtual void endList(bool /*ordered*/) {}
+  virtual void beginListItem() {}
+  virtual void endListItem() {}
+  virtual void beginQuote() {}
+  virtual void endQuote() {}
+  virtual void beginQuoteLine() {}
+  virtual void endQuoteLine() {}
+  // A table whose second row is all "-" cells has the first row as its header; the separator row
+  // itself is not reported.
+  virtual void beginTable() {}
+  virtual void endTable() {}
+  virtual void beginRow(bool /*header*/) {}
+  virtual void endRow(bool /*header*/) {}
+  virtual void beginCell(bool /*header*/) {}
+  virtual void endCell(bool /*header*/) {}
+  // Returning false skips the events for the definition's text.
+  virtual bool beginDefinition(std::string_view /*identifier*/) { return true; }
+  virtual void endDefinition() {}
+  virtual void code(const Code&) {}
+  virtual void toc() {}
+  virtual void references() {}
+
+  virtual void text(std::string_view) {}
+  virtual void beginInsertion() {}
+  virtual void endInsertion() {}
+  virtual void beginDeletion() {}
+  virtual void endDeletion() {}
+  virtual void reference(const Referenced&) {}
+  virtual void identifier(std::string_view) {}
+  virtual void codeSpan(std::string_view) {}
+};
+
+// Sends doc to all backends in one traversal.
+void render(const Document& doc, const std::vector<Backend*>& backends);
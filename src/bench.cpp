@@ -0,0 +1,324 @@
+#include "bench.h"
+#include "parser.h"
+#include "html.h"
+#include "plain_text.h"
+#include "markdown.h"
+#include "highlight.h"
+#include "highlight_cache.h"
+#include "escape.h"
+#include "alloc_count.h"
+#include "ast_file.h"
+#include <algorithm>
+#include <chrono>
+#include <random>
+#include <stdlib.h>
+#include <thread>
+
+// Set by the toolset, so results from different build profiles can be told apart.
+#ifndef FIETS_BUILD_PROFILE
+#define FIETS_BUILD_PROFILE unknown
+#endif
+#define STRINGIFY(x) #x
+#define EXPAND_STRINGIFY(x) STRINGIFY(x)
+
+// Discards its output, so only the cost of producing it is measured.
+struct NullSink : Sink {
+  NullSink() { pos = buffer; end = buffer + sizeof(buffer); }
+  size_t bytes = 0;
+  size_t written() const override { return bytes + (pos - buffer); }
+protected:
+  void overflow(std::string_view data) override { bytes += (pos - buffer) + data.size(); pos = buffer; }
+private:
+  char buffer[4096];
+};
+
+struct Measurement {
+  double seconds;
+  size_t allocations;
+};
+
+// Runs f once to count its heap allocations, then repeatedly until at least a quarter second has
+// passed, and returns the average seconds per run.
+template <typename F>
+static Measurement measure(F&& f) {
+  size_t before = allocation_count();
+  f();
+  size_t allocations = allocation_count() - before;
+  using clock = std::chrono::steady_clock;
+  auto start = clock::now();
+  size_t runs = 0;
+  std::chrono::duration<double> elapsed;
+  do {
+    f();
+    runs++;
+    elapsed = clock::now() - start;
+  } while (elapsed.count() < 0.25);
+  return { elapsed.count() / runs, allocations };
+}
+
+static void report(const char* phase, size_t bytes, Measurement m) {
+  printf("  %-10s %10zu bytes %10.2f MB/s", phase, bytes, bytes / m.seconds / 1e6);
+  if (counting_allocations) printf(" %10.2f allocs/KB", m.allocations * 1024.0 / (bytes ? bytes : 1));
+  printf("\n");
+}
+
+static void collect_code(const Chapter& ch, std::vector<std::string_view>& code) {
+  for (auto& entry : ch.entries) {
+    if (auto* c = std::get_if<Code>(&entry)) code.push_back(c->body);
+  }
+  for (auto& sub : ch.subchapters) collect_code(sub, code);
+}
+
+// The lines parse() hands to parseText(), approximately: everything outside code blocks that is
+// not a heading or a directive, with list, quote and table markers stripped.
+static void collect_prose(std::string_view source, std::vector<std::string_view>& lines) {
+  bool code = false;
+  size_t start = 0;
+  while (start < source.size()) {
+    size_t end = source.find('\n', start);
+    if (end == std::string_view::npos) end = source.size();
+    std::string_view line = source.substr(start, end - start);
+    start = end + 1;
+    if (line.starts_with("```")) code = !code;
+    else if (code || line.empty() || line.starts_with("#") || line.starts_with("[[")) continue;
+    else if (line.starts_with("- ") || line.starts_with("> ")) lines.push_back(line.substr(2));
+    else if (line.starts_with("|")) lines.push_back(line.substr(1, line.size() - 2));
+    else lines.push_back(line);
+  }
+}
+
+// Times each phase separately over a set of sources.
+static void bench_corpus(const char* name, const std::vector<std::string_view>& sources) {
+  size_t sourceBytes = 0;
+  for (auto& source : sources) sourceBytes += source.size();
+  printf("%s: %zu documents, %.2f MB\n", name, sources.size(), sourceBytes / 1e6);
+
+  report("parse", sourceBytes, measure([&] {
+    for (auto& source : sources) parse(source);
+  }));
+  size_t threads = std::max(1u, std::thread::hardware_concurrency());
+  char parallel[32];
+  snprintf(parallel, sizeof(parallel), "parse x%zu", threads);
+  report(parallel, sourceBytes, measure([&] {
+    for (auto& source : sources) parseParallel(source, threads);
+  }));
+
+  // The same sources read through a stream, as from stdin, in chunks.
+  report("parse pipe", sourceBytes, measure([&] {
+    for (auto& source : sources) {
+      FILE* in = fmemopen(const_cast<char*>(source.data()), source.size(), "r");
+      if (!in) continue;
+      parse(in);
+      fclose(in);
+    }
+  }));
+
+  std::vector<std::string_view> prose;
+  for (auto& source : sources) collect_prose(source, prose);
+  size_t proseBytes = 0;
+  for (auto& line : prose) proseBytes += line.size();
+  report("parseText", proseBytes, measure([&] {
+    Document scratch;
+    for (auto& line : prose) parseText(line, scratch);
+  }));
+
+  std::vector<Document> docs;
+  for (auto& source : sources) docs.push_back(parse(source));
+  std::vector<std::string_view> code;
+  for (auto& doc : docs) collect_code(doc, code);
+  size_t codeBytes = 0;
+  for (auto& c : code) codeBytes += c.size();
+  report("highlight", codeBytes, measure([&] {
+    NullSink out;
+    for (auto& c : code) highlight(out, c);
+  }));
+
+  report("as_html", sourceBytes, measure([&] {
+    NullSink out;
+    for (auto& doc : docs) as_html(out, doc);
+  }));
+  // With every snippet already in the highlight cache, as for papers after the first in a batch.
+  HighlightCache highlights;
+  report("as_html hc", sourceBytes, measure([&] {
+    NullSink out;
+    for (auto& doc : docs) as_html(out, doc, nullptr, &highlights);
+  }));
+  printf("  (highlight cache: %zu snippets, %zu hits, %zu misses)\n", highlights.entries(), highlights.hits, highlights.misses);
+  // HTML, plain text and Markdown from one walk, against the cost of HTML alone above.
+  report("all three", sourceBytes, measure([&] {
+    NullSink html, text, markdown;
+    HtmlBackend htmlBackend(html);
+    PlainTextBackend textBackend(text);
+    MarkdownBackend markdownBackend(markdown);
+    for (auto& doc : docs) render(doc, { &htmlBackend, &textBackend, &markdownBackend });
+  }));
+
+  // Loading a saved tree against parsing the text it came from; throughput is per source byte. The
+  // files go in a directory of their own, so benches running side by side do not share them.
+  std::string dir = (std::filesystem::temp_directory_path() / "fiets-bench-XXXXXX").string();
+  if (!mkdtemp(dir.data())) {
+    fprintf(stderr, "Cannot create %s\n", dir.c_str());
+    return;
+  }
+  std::vector<std::filesystem::path> saved;
+  size_t savedBytes = 0;
+  for (auto& doc : docs) {
+    saved.push_back(std::filesystem::path(dir) / (std::to_string(saved.size()) + ".ast"));
+    if (!save(doc, saved.back())) fprintf(stderr, "Cannot write %s\n", saved.back().c_str());
+    std::error_code ec;
+    savedBytes += std::filesystem::file_size(saved.back(), ec);
+  }
+  report("save", sourceBytes, measure([&] {
+    for (size_t n = 0; n < docs.size(); n++) save(docs[n], saved[n]);
+  }));
+  report("load", sourceBytes, measure([&] {
+    for (auto& path : saved) load(path);
+  }));
+  printf("  (%zu bytes saved)\n", savedBytes);
+  std::error_code ec;
+  std::filesystem::remove_all(dir, ec);
+}
+
+// Writes a paper of about options.size bytes. Each block is a code block, table, link-heavy
+// paragraph or markup-heavy paragraph with the configured probabilities, and plain prose otherwise.
+static std::string generate(const BenchOptions& options) {
+  std::mt19937 rng(12345);
+  std::uniform_real_distribution<double> pick(0, 1);
+  auto word = [&] {
+    static const char* words[] = { "the", "contract", "vector", "is", "evaluated", "when", "a", "pointer",
+                                   "of", "type", "module", "profile", "and", "safety", "requires", "that" };
+    return words[rng() % std::size(words)];
+  };
+  auto sentence = [&](std::string& out, size_t words) {
+    for (size_t n = 0; n < words; n++) out += std::string(n ? " " : "") + word();
+    out += ". ";
+  };
+  std::string out = "Synthetic benchmark paper\nGenerated corpus\n\n[[TOC]]\n\n";
+  size_t blocks = 0;
+  while (out.size() < options.size) {
+    if (blocks++ % 40 == 0) out += "\n# Chapter " + std::to_string(blocks / 40 + 1) + "\n\n";
+    else if (blocks % 10 == 0) out += "\n## Section " + std::to_string(blocks) + "\n\n";
+    double r = pick(rng);
+    if ((r -= options.code) < 0) {
+      out += "```\n";
+      for (size_t n = 0, lines = 5 + rng() % 10; n < lines; n++) {
+        out += "template <typename T> constexpr auto f" + std::to_string(n) + "(const std::vector<T>& v) noexcept { return v.size() * 2; } // note\n";
+      }
+      out += "```\n";
+    } else if ((r -= options.tables) < 0) {
+      out += "| Name | Value | Notes |\n|-|-|-|\n";
+      for (size_t n = 0, rows = 3 + rng() % 6; n < rows; n++) {
+        out += "| row" + std::to_string(n) + " | `std::size_t` | ";
+        sentence(out, 6);
+        out += "|\n";
+      }
+    } else if ((r -= options.links) < 0) {
+      for (size_t n = 0; n < 4; n++) {
+        sentence(out, 8);
+        size_t paper = rng() % 500;
+        out += "See [P" + std::to_string(paper) + "](https://wg21.link/p" + std::to_string(paper) + ") and [N" + std::to_string(paper) + "]. ";
+      }
+      out += "\n";
+    } else if ((r -= options.markup) < 0) {
+      for (size_t n = 0; n < 4; n++) {
+        sentence(out, 6);
+        out += "Use `std::vector<int>` with 'value_type', +++added text+++ and ---removed text---. ";
+      }
+      out += "\n";
+    } else {
+      for (size_t n = 0; n < 5; n++) sentence(out, 12);
+      out += "\n";
+    }
+    out += "\n";
+  }
+  out += "\n# References\n\n[[references]]\n";
+  return out;
+}
+
+// A paper citing the same few hundred URLs over and over, as reference-heavy papers do. Without
+// links, the same text with the brackets taken out, so that it is parsed as plain prose.
+static std::string link_heavy_document(size_t links, bool asLinks = true) {
+  std::string source = "Links\n\n# Chapter\n";
+  for (size_t n = 0; n < links; n++) {
+    std::string common = std::to_string(n % 400), unique = std::to_string(n);
+    if (asLinks) source += "See [P" + common + "](https://wg21.link/p" + common + ") and [P" + unique + "](https://wg21.link/p" + unique + "r1).\n";
+    else source += "See P" + common + " (https://wg21.link/p" + common + ") and P" + unique + " (https://wg21.link/p" + unique + "r1).\n";
+  }
+  return source;
+}
+
+// Parse time per link should stay flat as the link count grows. Larger documents are slower per
+// byte anyway once they no longer fit in the caches, so each paper is timed against the same text
+// without links. Returns how much that ratio grows from 2000 to 32000 links.
+static double bench_references() {
+  printf("references:\n");
+  double first = 0, last = 0;
+  for (size_t links : { 2000, 8000, 32000 }) {
+    std::string source = link_heavy_document(links / 2), plain = link_heavy_document(links / 2, false);
+    Measurement m = measure([&] { parse(source); });
+    Measurement p = measure([&] { parse(plain); });
+    last = m.seconds / p.seconds;
+    if (!first) first = last;
+    printf("  %-10s %10zu links %10.1f ns/link %10.2fx prose\n", "parse", links, m.seconds / links * 1e9, last);
+  }
+  printf("  %-10s %10.2fx from 2000 to 32000 links\n", "growth", last / first);
+  return last / first;
+}
+
+// Worst case for the escaper: C++ prose where every few characters is an angle bracket.
+static void bench_escape() {
+  std::string text;
+  while (text.size() < (1 << 20)) text += "std::vector<std::pair<T, U>> && ";
+  printf("escape:\n");
+  report("escape", text.size(), measure([&] {
+    NullSink out;
+    escape_html(out, text);
+  }));
+}
+
+int bench(const BenchOptions& options) {
+#if defined(__OPTIMIZE__)
+  const char* optimised = "optimised";
+#else
+  const char* optimised = "not optimised";
+#endif
+  printf("build: %s (%s, %s%s)\n", EXPAND_STRINGIFY(FIETS_BUILD_PROFILE), __VERSION__, optimised,
+         counting_allocations ? "" : ", allocations not counted: build with FIETS_COUNT_ALLOCATIONS=1");
+  std::vector<Document> papers;
+  std::vector<std::string_view> sources;
+  for (auto& path : options.inputs) {
+    std::unique_ptr<MappedFile> source = MappedFile::open(path);
+    if (!source) {
+      fprintf(stderr, "Cannot read %s\n", path.c_str());
+      return 1;
+    }
+    papers.push_back(parse(std::move(source)));
+    sources.push_back(papers.back().source->data());
+  }
+  if (!sources.empty()) bench_corpus("papers", sources);
+
+  std::string synthetic = generate(options);
+  if (!options.writeSynthetic.empty()) {
+    FileSink out(options.writeSynthetic);
+    out << synthetic;
+    if (!out.close()) {
+      fprintf(stderr, "Cannot write %s\n", options.writeSynthetic.c_str());
+      return 1;
+    }
+  }
+  printf("(synthetic mix: code %.2f, tables %.2f, links %.2f, markup %.2f)\n", options.code, options.tables, options.links, options.markup);
+  bench_corpus("synthetic", { synthetic });
+  bench_escape();
+  bench_references();
+  return 0;
+}
+
+// The growing reference index costs up to about 2x in cache misses; scanning the reference list
+// for every link gave about 5x. Timing noise only adds, so the best of a few runs is compared.
+int bench_check() {
+  constexpr double limit = 3;
+  double best = bench_references();
+  for (int run = 1; run < 5 && best > limit; run++) best = std::min(best, bench_references());
+  printf("reference growth %.2fx (limit %.1fx): %s\n", best, limit, best <= limit ? "linear" : "not linear");
+  return best <= limit ? 0 : 1;
+}
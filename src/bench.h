@@ -0,0 +1,22 @@
+#pragma once
+
+#include <filesystem>
+#include <vector>
+
+struct BenchOptions {
+  std::vector<std::filesystem::path> inputs;
+  // Approximate size of the synthetic paper in bytes, and the share of its blocks that are code
+  // blocks, tables, link-heavy and markup-heavy paragraphs; the rest is plain prose.
+  size_t size = 4 << 20;
+  double code = 0.2, tables = 0.1, links = 0.15, markup = 0.15;
+  // Where to save the synthetic paper, if anywhere.
+  std::filesystem::path writeSynthetic;
+};
+
+// Times parse(), parseText(), highlight() and as_html() separately on the given papers and on a
+// generated one, and prints throughput and allocations per phase.
+int bench(const BenchOptions& options);
+
+// Fails (returns nonzero) if parse time per link grows with the number of links, as it does when
+// references are looked up by scanning. Kept out of bench() because it depends on timing.
+int bench_check();
@@ -0,0 +1,34 @@
+#include "cache.h"
+#include <fstream>
+
+BuildCache::BuildCache(std::filesystem::path dir)
+: file(dir / ".fiets-cache")
+{
+  std::ifstream in(file);
+  std::string name;
+  uint64_t key;
+  while (in >> std::hex >> key && std::getline(in >> std::ws, name)) {
+    entries[name] = key;
+  }
+}
+
+bool BuildCache::fresh(const std::filesystem::path& output, uint64_t key) {
+  std::lock_guard<std::mutex> lock(mutex);
+  auto it = entries.find(output.filename().string());
+  bool hit = it != entries.end() && it->second == key && std::filesystem::exists(output);
+  if (hit) hits++; else misses++;
+  return hit;
+}
+
+void BuildCache::store(const std::filesystem::path& output, uint64_t key) {
+  std::lock_guard<std::mutex> lock(mutex);
+  entries[output.filename().string()] = key;
+}
+
+void BuildCache::save() {
+  std::lock_guard<std::mutex> lock(mutex);
+  std::ofstream out(file);
+  for (auto& [name, key] : entries) {
+    out << std::hex << key << ' ' << name << '\n';
+  }
+}
@@ -0,0 +1,21 @@
+#pragma once
+
+#include <cstdint>
+#include <filesystem>
+#include <map>
+#include <mutex>
+#include <string>
+
+// Records which source hash every output in a directory was rendered from, so unchanged
+// papers can be skipped. Stored as "<hex key> <output name>" lines in <dir>/.fiets-cache.
+struct BuildCache {
+  BuildCache(std::filesystem::path dir);
+  bool fresh(const std::filesystem::path& output, uint64_t key);
+  void store(const std::filesystem::path& output, uint64_t key);
+  void save();
+  size_t hits = 0, misses = 0;
+private:
+  std::filesystem::path file;
+  std::map<std::string, uint64_t> entries;
+  std::mutex mutex;
+};
@@ -0,0 +1,63 @@
+#include "check.h"
+#include "parser.h"
+#include "html.h"
+#include <algorithm>
+#include <vector>
+
+// Prints the line of text that contains offset, clipped to a window around it, and a caret under offset.
+static void show(const char* label, std::string_view text, size_t offset) {
+  size_t lineStart = text.rfind('\n', offset ? offset - 1 : 0);
+  lineStart = lineStart == std::string_view::npos || offset == 0 ? 0 : lineStart + 1;
+  size_t lineEnd = std::min(text.find('\n', offset), text.size());
+  size_t from = std::max(lineStart, offset < 60 ? 0 : offset - 60);
+  size_t to = std::min(lineEnd, offset + 60);
+  std::string_view shown = text.substr(from, to - from);
+  fprintf(stderr, "  %-9s %.*s%s\n", label, (int)shown.size(), shown.data(), offset >= text.size() ? "<end of file>" : "");
+  fprintf(stderr, "  %-9s %*s^\n", "", (int)(offset - from), "");
+}
+
+static bool compare(const std::string& name, std::string_view expected, std::string_view actual) {
+  auto [e, a] = std::mismatch(expected.begin(), expected.end(), actual.begin(), actual.end());
+  if (e == expected.end() && a == actual.end()) return true;
+  size_t offset = e - expected.begin();
+  size_t line = 1 + std::count(expected.begin(), e, '\n');
+  size_t column = offset - (expected.substr(0, offset).rfind('\n') + 1) + 1;
+  fprintf(stderr, "%s: differs at line %zu, column %zu (byte %zu)\n", name.c_str(), line, column, offset);
+  show("expected:", expected, offset);
+  show("actual:", actual, offset);
+  return false;
+}
+
+int check(const std::filesystem::path& papers, const std::filesystem::path& goldens, bool update) {
+  std::vector<std::filesystem::path> inputs;
+  for (auto& entry : std::filesystem::directory_iterator(papers)) {
+    if (entry.path().extension() != ".fiets") continue;
+    if (std::filesystem::exists(goldens / entry.path().stem().concat(".html"))) inputs.push_back(entry.path());
+  }
+  std::sort(inputs.begin(), inputs.end());
+  size_t failures = 0;
+  for (auto& input : inputs) {
+    std::filesystem::path golden = goldens / input.stem().concat(".html");
+    std::unique_ptr<MappedFile> source = MappedFile::open(input);
+    std::unique_ptr<MappedFile> expected = MappedFile::open(golden);
+    if (!source || !expected) {
+      fprintf(stderr, "Cannot read %s\n", (source ? golden : input).c_str());
+      failures++;
+      continue;
+    }
+    std::string actual = as_html(parse(std::move(source)));
+    if (update) {
+      expected.reset();
+      FileSink out(golden);
+      out << actual;
+      if (!out.close()) {
+        fprintf(stderr, "Cannot write %s\n", golden.c_str());
+        failures++;
+      }
+    } else if (!compare(input.stem().string(), expected->data(), actual)) {
+      failures++;
+    }
+  }
+  printf("%s %zu papers, %zu failed\n", update ? "updated" : "checked", inputs.size(), failures);
+  return failures ? 1 : 0;
+}
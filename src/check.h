@@ -0,0 +1,8 @@
+#pragma once
+
+#include <filesystem>
+
+// Renders every paper in papers that has a <name>.html counterpart in goldens and compares the
+// output byte for byte, printing the first divergence of each mismatch. With update the goldens
+// are rewritten instead. Returns nonzero if any output differs or cannot be produced.
+int check(const std::filesystem::path& papers, const std::filesystem::path& goldens, bool update);
@@ -0,0 +1,48 @@
+#include "diagnostics.h"
+
+static const char* name(Severity severity) {
+  switch(severity) {
+  case Severity::Note: return "note";
+  case Severity::Warning: return "warning";
+  case Severity::Error: return "error";
+  }
+  return "";
+}
+
+void Diagnostics::report(Severity severity, size_t line, size_t column, std::string message) {
+  entries.push_back(Diagnostic{severity, line, column, std::move(message)});
+}
+
+void Diagnostics::print(FILE* out) const {
+  for (auto& d : entries) {
+    fprintf(out, "%s:%zu:%zu: %s: %s\n", file.c_str(), d.line, d.column, name(d.severity), d.message.c_str());
+  }
+}
+
+static void write_json_string(Sink& out, std::string_view s) {
+  static const char hex[] = "0123456789abcdef";
+  out << '"';
+  for (char c : s) {
+    if (c == '"' || c == '\\') out << '\\' << c;
+    else if (c == '\n') out << "\\n";
+    else if ((unsigned char)c < 0x20) out << "\\u00" << hex[c >> 4] << hex[c & 0xF];
+    else out << c;
+  }
+  out << '"';
+}
+
+void write_json(Sink& out, const std::vector<Diagnostics>& all) {
+  out << "[";
+  bool first = true;
+  for (auto& diagnostics : all) {
+    for (auto& d : diagnostics.entries) {
+      out << (first ? "\n" : ",\n") << "{\"file\":";
+      write_json_string(out, diagnostics.file);
+      out << ",\"severity\":\"" << name(d.severity) << "\",\"line\":" << d.line << ",\"column\":" << d.column << ",\"message\":";
+      write_json_string(out, d.message);
+      out << "}";
+      first = false;
+    }
+  }
+  out << "\n]\n";
+}
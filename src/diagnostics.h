@@ -0,0 +1,30 @@
+#pragma once
+
+#include "sink.h"
+#include <string>
+#include <vector>
+
+enum class Severity {
+  Note,
+  Warning,
+  Error,
+};
+
+struct Diagnostic {
+  Severity severity;
+  size_t line, column;
+  std::string message;
+};
+
+// Problems found while processing one input. Code that can report them takes a Diagnostics*;
+// passing nullptr turns reporting off at the cost of a pointer test.
+struct Diagnostics {
+  std::string file;
+  std::vector<Diagnostic> entries;
+  void report(Severity severity, size_t line, size_t column, std::string message);
+  // Prints as "file:line:column: severity: message" lines.
+  void print(FILE* out) const;
+};
+
+// Writes all diagnostics as one JSON array of {file, severity, line, column, message} objects.
+void write_json(Sink& out, const std::vector<Diagnostics>& all);
@@ -0,0 +1,67 @@
+#include "escape.h"
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+static bool needs_escape(char c) {
+  return c == '&' || c == '<' || c == '>' || c == '"';
+}
+
+// Returns the offset of the first character at or after offset that needs escaping, or text.size().
+static size_t find_escape(std::string_view text, size_t offset) {
+#if defined(__SSE2__)
+  while (offset + 16 <= text.size()) {
+    __m128i v = _mm_loadu_si128((const __m128i*)(text.data() + offset));
+    __m128i hits = _mm_or_si128(_mm_or_si128(_mm_cmpeq_epi8(v, _mm_set1_epi8('&')), _mm_cmpeq_epi8(v, _mm_set1_epi8('<'))),
+                                _mm_or_si128(_mm_cmpeq_epi8(v, _mm_set1_epi8('>')), _mm_cmpeq_epi8(v, _mm_set1_epi8('"'))));
+    unsigned mask = _mm_movemask_epi8(hits);
+    if (mask) return offset + __builtin_ctz(mask);
+    offset += 16;
+  }
+#endif
+  while (offset < text.size() && !needs_escape(text[offset])) offset++;
+  return offset;
+}
+
+static bool is_digit(char c) { return c >= '0' && c <= '9'; }
+static bool is_hex(char c) { return is_digit(c) || (c >= 'a' && c <= 'f') || (c >= 'A' && c <= 'F'); }
+static bool is_alpha(char c) { return (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z'); }
+static bool is_alnum(char c) { return is_digit(c) || is_alpha(c); }
+
+// Length of the character reference (&name; &#123; &#x1F;) starting at offset, or 0 if there is
+// none. Papers write these on purpose, so they are passed through rather than escaped.
+static size_t reference_length(std::string_view text, size_t offset) {
+  size_t n = offset + 1;
+  bool (*valid)(char) = is_alnum;
+  if (n < text.size() && text[n] == '#') {
+    n++;
+    valid = is_digit;
+    if (n < text.size() && (text[n] == 'x' || text[n] == 'X')) {
+      n++;
+      valid = is_hex;
+    }
+  } else if (n >= text.size() || !is_alpha(text[n])) {
+    return 0;
+  }
+  size_t first = n;
+  while (n < text.size() && n - offset < 32 && valid(text[n])) n++;
+  if (n == first || n >= text.size() || text[n] != ';') return 0;
+  return n + 1 - offset;
+}
+
+void escape_html(Sink& out, std::string_view text) {
+  size_t start = 0;
+  for (size_t offset = find_escape(text, 0); offset != text.size(); offset = find_escape(text, start)) {
+    out << text.substr(start, offset - start);
+    size_t reference = text[offset] == '&' ? reference_length(text, offset) : 0;
+    switch(reference ? 0 : text[offset]) {
+    case 0: out << text.substr(offset, reference); break;
+    case '&': out << "&amp;"; break;
+    case '<': out << "&lt;"; break;
+    case '>': out << "&gt;"; break;
+    case '"': out << "&quot;"; break;
+    }
+    start = offset + (reference ? reference : 1);
+  }
+  out << text.substr(start);
+}
@@ -0,0 +1,16 @@
+#pragma once
+
+#include "sink.h"
+#include <string_view>
+
+// Writes text with &, <, > and " replaced by entities, so it is safe both as element content
+// and inside a double-quoted attribute.
+void escape_html(Sink& out, std::string_view text);
+
+// Marks text to be escaped on output: out << Escaped{text}.
+struct Escaped { std::string_view text; };
+
+inline Sink& operator<<(Sink& out, Escaped e) {
+  escape_html(out, e.text);
+  return out;
+}
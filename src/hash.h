@@ -0,0 +1,17 @@
+#pragma once
+
+#include <cstdint>
+#include <string_view>
+
+// 64-bit FNV-1a; chain calls by passing the previous result as seed.
+constexpr uint64_t hash(std::string_view data, uint64_t seed = 0xcbf29ce484222325ULL) {
+  for (unsigned char c : data) {
+    seed ^= c;
+    seed *= 0x100000001b3ULL;
+  }
+  return seed;
+}
+
+inline uint64_t hash(uint64_t value, uint64_t seed) {
+  return hash(std::string_view(reinterpret_cast<const char*>(&value), sizeof(value)), seed);
+}
@@ -0,0 +1,349 @@
+#include "highlight.h"
+#include "stats.h"
+#include <array>
+#include <cstdint>
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+enum CharacterType : uint8_t {
+  Alnum = 0,
+  Space = 1,
+  Special = 2,
+  Control = 3,
+  Other = 4,
+  Escape = 5,
+  // Punctuation a grammar leaves unmarked.
+  Plain = 6,
+  // Opens a string, which runs to the same character.
+  Quote = 7,
+  // Starts a variable reference: $name, ${name} or $1.
+  Dollar = 8,
+};
+
+// Keywords are found with a perfect hash: FNV-1a with a seed that compile() searches for, so
+// that every keyword of the grammar lands in its own slot and a lookup is one compare.
+constexpr size_t keyword_slots = 1024;
+
+constexpr char fold(char c, bool foldCase) {
+  return foldCase && c >= 'A' && c <= 'Z' ? char(c + 32) : c;
+}
+
+constexpr uint32_t keyword_hash(std::string_view word, uint32_t seed, bool foldCase) {
+  uint32_t h = seed;
+  for (char c : word) h = (h ^ (unsigned char)fold(c, foldCase)) * 0x01000193;
+  return h >> 22;
+}
+
+// What a grammar is compiled from.
+struct Rules {
+  std::string_view lineComment, blockOpen, blockClose;
+  // Punctuation marked as special; all of it when empty and markPunctuation is set.
+  std::string_view special;
+  bool markPunctuation = false;
+  std::string_view quotes;
+  bool variables = false;
+  // Keywords match in any case, as CMake commands do.
+  bool foldCase = false;
+  // A comment only starts at the start of a word, as # in a shell.
+  bool commentAfterSpace = false;
+};
+
+// A language's highlighting rules as tables, built at compile time: the type of every byte and
+// the keyword slots. The scanner below only indexes these.
+struct Grammar {
+  std::array<CharacterType, 256> types{};
+  // Bytes a comment can start with.
+  std::array<bool, 256> opensComment{};
+  // Slot -> 1 + index into keywords, or 0 when empty.
+  std::array<uint16_t, keyword_slots> slots{};
+  uint32_t seed = 0;
+  const std::string_view* keywords = nullptr;
+  Rules rules;
+
+  bool is_keyword(std::string_view word) const {
+    uint16_t slot = slots[keyword_hash(word, seed, rules.foldCase)];
+    if (!slot) return false;
+    std::string_view keyword = keywords[slot - 1];
+    if (!rules.foldCase) return keyword == word;
+    if (keyword.size() != word.size()) return false;
+    for (size_t n = 0; n < word.size(); n++) {
+      if (fold(word[n], true) != keyword[n]) return false;
+    }
+    return true;
+  }
+};
+
+// Alnum, Space and Other are the same in every grammar, which is what lets run_end() search for
+// them with SIMD.
+template <size_t N>
+constexpr Grammar compile(const std::string_view (&keywords)[N], Rules rules) {
+  Grammar g;
+  for (size_t ch = 0; ch < 256; ch++) {
+    if (ch == '<' || ch == '>' || ch == '&') g.types[ch] = Escape;
+    else if (ch == 0x08 || ch == 0x0a || ch == 0x0d || ch == 0x20) g.types[ch] = Space;
+    else if (ch >= 0x80) g.types[ch] = Other;
+    else if (ch == 0x7F || ch < 0x20) g.types[ch] = Control;
+    else if ((ch >= '0' && ch <= '9') ||
+             (ch >= 'a' && ch <= 'z') ||
+             (ch >= 'A' && ch <= 'Z') ||
+             ch == '_') g.types[ch] = Alnum;
+    else if (rules.markPunctuation || rules.special.find(char(ch)) != std::string_view::npos) g.types[ch] = Special;
+    else g.types[ch] = Plain;
+  }
+  for (char ch : rules.quotes) g.types[(unsigned char)ch] = Quote;
+  if (rules.variables) g.types['$'] = Dollar;
+  if (!rules.lineComment.empty()) g.opensComment[(unsigned char)rules.lineComment[0]] = true;
+  if (!rules.blockOpen.empty()) g.opensComment[(unsigned char)rules.blockOpen[0]] = true;
+  for (bool placed = false; !placed; ) {
+    g.seed++;
+    g.slots = {};
+    placed = true;
+    for (size_t n = 0; n < N && placed; n++) {
+      uint32_t slot = keyword_hash(keywords[n], g.seed, rules.foldCase);
+      placed = !g.slots[slot];
+      g.slots[slot] = n + 1;
+    }
+  }
+  g.keywords = keywords;
+  g.rules = rules;
+  return g;
+}
+
+constexpr std::string_view cpp_keywords[] = {
+  "alignas", "alignof", "and_eq", "and", "asm", "auto", "bitand", "bitor", "bool", "break",
+  "case", "catch", "char8_t", "char16_t", "char32_t", "char", "class", "compl", "contract_assert", "const_cast",
+  "constexpr", "consteval", "constinit", "const", "continue", "decltype", "default", "delete", "do", "double",
+  "dynamic_cast", "else", "enum", "explicit", "extern", "false", "final", "float", "for",
+  "friend", "goto", "if", "inline", "int", "long", "mutable", "namespace", "new", "noexcept",
+  "not_eq", "not", "nullptr", "operator", "or_eq", "or", "override", "pre", "post", "private", "protected",
+  "public", "register", "reinterpret_cast", "return", "short", "signed", "sizeof",
+  "static_assert", "static_cast", "static", "struct", "switch", "template", "this",
+  "thread_local", "throw", "true", "try", "typedef", "typeid", "typename", "union",
+  "unsigned", "using", "virtual", "void", "volatile", "wchar_t", "while", "xor_eq", "xor",
+};
+
+// Commands and the common keyword arguments.
+constexpr std::string_view cmake_keywords[] = {
+  "cmake_minimum_required", "project", "if", "elseif", "else", "endif", "foreach", "endforeach",
+  "while", "endwhile", "function", "endfunction", "macro", "endmacro", "block", "endblock", "return",
+  "break", "continue", "set", "unset", "option", "list", "string", "math", "file", "message", "include",
+  "find_package", "find_library", "find_path", "find_program", "add_executable", "add_library",
+  "add_subdirectory", "add_custom_command", "add_custom_target", "add_dependencies", "add_test",
+  "add_compile_definitions", "add_compile_options", "add_link_options", "enable_testing",
+  "configure_file", "install", "export", "target_link_libraries", "target_include_directories",
+  "target_compile_definitions", "target_compile_options", "target_compile_features", "target_sources",
+  "target_link_options", "set_target_properties", "set_property", "get_property", "get_target_property",
+  "include_directories", "link_directories", "link_libraries", "get_filename_component", "execute_process",
+  "public", "private", "interface", "required", "components", "not", "and", "or", "defined", "strequal",
+  "equal", "less", "greater", "matches", "exists", "version_less", "version_greater", "version_equal",
+  "cache", "parent_scope", "force", "static", "shared", "object", "imported", "alias", "in", "lists", "items",
+};
+
+constexpr std::string_view shell_keywords[] = {
+  "if", "then", "else", "elif", "fi", "for", "while", "until", "do", "done", "case", "esac", "in",
+  "function", "select", "time", "return", "exit", "local", "export", "readonly", "declare", "unset",
+  "shift", "break", "continue", "source", "alias", "set", "eval", "exec", "trap", "cd", "echo", "test",
+};
+
+// C++ marks all punctuation and knows // and /* */ comments; strings are not treated specially.
+// CMake and shell only mark the punctuation that structures a command, and know # comments,
+// strings and $ variables. Text only escapes.
+constexpr Grammar cpp_grammar = compile(cpp_keywords, Rules{ "//", "/*", "*/", "", true, "", false, false, false });
+constexpr Grammar cmake_grammar = compile(cmake_keywords, Rules{ "#", "", "", "()", false, "\"", true, true, false });
+constexpr Grammar shell_grammar = compile(shell_keywords, Rules{ "#", "", "", "|;()", false, "\"'`", true, false, true });
+constexpr std::string_view no_keywords[] = { "" };
+constexpr Grammar text_grammar = compile(no_keywords, Rules{});
+
+#if defined(__SSE2__)
+static __m128i in_range(__m128i v, char lo, char hi) {
+  // Shift [lo, hi] down to the bottom of the signed range so one signed compare does an unsigned range check.
+  __m128i shifted = _mm_add_epi8(v, _mm_set1_epi8(char(0x80 - lo)));
+  return _mm_cmplt_epi8(shifted, _mm_set1_epi8(char(0x80 + (hi - lo + 1))));
+}
+
+// Lanes whose byte is of the given type; only the types that form long runs are vectorised.
+static __m128i matching(__m128i v, CharacterType type) {
+  switch(type) {
+  case Alnum:
+    return _mm_or_si128(_mm_or_si128(in_range(v, '0', '9'), in_range(_mm_or_si128(v, _mm_set1_epi8(0x20)), 'a', 'z')),
+                        _mm_cmpeq_epi8(v, _mm_set1_epi8('_')));
+  case Space:
+    return _mm_or_si128(_mm_or_si128(_mm_cmpeq_epi8(v, _mm_set1_epi8(0x08)), _mm_cmpeq_epi8(v, _mm_set1_epi8(0x0a))),
+                        _mm_or_si128(_mm_cmpeq_epi8(v, _mm_set1_epi8(0x0d)), _mm_cmpeq_epi8(v, _mm_set1_epi8(0x20))));
+  case Other:
+    return _mm_cmplt_epi8(v, _mm_setzero_si128());
+  default:
+    return _mm_setzero_si128();
+  }
+}
+#endif
+
+// Returns the end of the run of characters of the given type that starts at offset.
+template <const Grammar& g>
+static size_t run_end(std::string_view text, size_t offset, CharacterType type) {
+#if defined(__SSE2__)
+  if (type == Alnum || type == Space || type == Other) {
+    while (offset + 16 <= text.size()) {
+      __m128i v = _mm_loadu_si128((const __m128i*)(text.data() + offset));
+      unsigned mask = _mm_movemask_epi8(matching(v, type));
+      if (mask != 0xFFFF) return offset + __builtin_ctz(~mask);
+      offset += 16;
+    }
+  }
+#endif
+  while (offset < text.size() && g.types[(unsigned char)text[offset]] == type) offset++;
+  return offset;
+}
+
+// Code is shown as written, so unlike escape_html() every & is escaped.
+static void escape_code(Sink& out, std::string_view text) {
+  size_t start = 0;
+  for (size_t n = 0; n < text.size(); n++) {
+    if (text[n] != '<' && text[n] != '>' && text[n] != '&') continue;
+    out << text.substr(start, n - start) << (text[n] == '<' ? "&lt;" : text[n] == '>' ? "&gt;" : "&amp;");
+    start = n + 1;
+  }
+  out << text.substr(start);
+}
+
+// Returns the end of the variable reference starting with the $ at offset, or offset + 1 for a
+// lone $. Braces nest, as in ${a_${b}}.
+template <const Grammar& g>
+static size_t variable_end(std::string_view text, size_t offset) {
+  size_t n = offset + 1;
+  if (n >= text.size()) return n;
+  if (text[n] == '{') {
+    size_t depth = 0;
+    for (; n < text.size(); n++) {
+      if (text[n] == '{') depth++;
+      else if (text[n] == '}' && --depth == 0) return n + 1;
+      else if (text[n] == '\n') return n;
+    }
+    return n;
+  }
+  if (g.types[(unsigned char)text[n]] == Alnum) return run_end<g>(text, n, Alnum);
+  if (std::string_view("?@#*!$-").find(text[n]) != std::string_view::npos) return n + 1;
+  return n;
+}
+
+// Returns the end of the string whose opening quote is at offset; a backslash escapes the next
+// character except in single quotes. An unterminated string runs to the end of its line.
+static size_t string_end(std::string_view text, size_t offset) {
+  char quote = text[offset];
+  for (size_t n = offset + 1; n < text.size(); n++) {
+    if (text[n] == quote) return n + 1;
+    if (text[n] == '\n') return n;
+    if (text[n] == '\\' && quote != '\'') n++;
+  }
+  return text.size();
+}
+
+template <const Grammar& g>
+static void flush_token(Sink& out, CharacterType current, std::string_view token) {
+  // Grammars that mark no punctuation leave < > & unmarked too.
+  constexpr bool marked = g.rules.markPunctuation || !g.rules.special.empty();
+  switch(current) {
+  case Alnum:
+    if (g.is_keyword(token)) {
+      out << "<span class=\"keyword\">" << token << "</span>";
+    } else {
+      out << token;
+    }
+    break;
+  case Space:
+  case Other:
+    out << token;
+    break;
+  case Plain:
+  case Quote:
+  case Dollar:
+    escape_code(out, token);
+    break;
+  case Escape:
+    if (marked) out << "<span class=\"special\">";
+    for (auto& ch : token) {
+      out << (ch == '<' ? "&lt;" : ch == '>' ? "&gt;" : "&amp;");
+    }
+    if (marked) out << "</span>";
+    break;
+  case Special:
+    out << "<span class=\"special\">" << token << "</span>";
+    break;
+  case Control:
+    // Should nevr happen. Maybe transcode?
+    out << token;
+    break;
+  }
+}
+
+// Returns whether a comment starts at offset, and sets end and next to where its text ends and
+// where scanning resumes. A line comment takes its line break with it.
+template <const Grammar& g>
+static bool comment_at(std::string_view text, size_t offset, size_t& end, size_t& next) {
+  const Rules& r = g.rules;
+  if (r.commentAfterSpace && offset > 0 && g.types[(unsigned char)text[offset - 1]] != Space) return false;
+  if (!r.lineComment.empty() && text[offset] == r.lineComment[0] && text.substr(offset).starts_with(r.lineComment)) {
+    end = text.find('\n', offset + r.lineComment.size());
+    next = end + 1;
+  } else if (!r.blockOpen.empty() && text[offset] == r.blockOpen[0] && text.substr(offset).starts_with(r.blockOpen)) {
+    end = text.find(r.blockClose, offset + r.blockOpen.size() - 1);
+    if (end != std::string_view::npos) end = next = end + r.blockClose.size();
+  } else {
+    return false;
+  }
+  return true;
+}
+
+// Instantiated per grammar, so its tables are constants in the scanning loop.
+template <const Grammar& g>
+static void scan(Sink& out, std::string_view text) {
+  CharacterType current = Control;
+  size_t start = 0, offset = 0;
+  while (offset < text.size()) {
+    current = g.types[(unsigned char)text[offset]];
+    start = offset;
+    // A comment is only looked for where a run starts, so in C++ a run of punctuation has to open
+    // with // or /*. The comment is followed by a line break; one left open at the end of the text
+    // is flushed as the run it started.
+    size_t end, next;
+    if (g.opensComment[(unsigned char)text[offset]] && comment_at<g>(text, offset, end, next)) {
+      if (end == std::string_view::npos) {
+        // Unlike a real run this can hold anything, so it is escaped.
+        bool marked = current == Special;
+        if (marked) out << "<span class=\"special\">";
+        escape_code(out, text.substr(offset));
+        if (marked) out << "</span>";
+        return;
+      }
+      out << "<span class=\"comment\">";
+      escape_code(out, text.substr(offset, end - offset));
+      out << "</span><br>";
+      start = offset = next;
+      continue;
+    }
+    // The grammar is a constant here, so these tests vanish for grammars without strings or variables.
+    bool quote = !g.rules.quotes.empty() && current == Quote;
+    bool variable = g.rules.variables && current == Dollar;
+    if (quote) offset = string_end(text, offset);
+    else if (variable) offset = variable_end<g>(text, offset);
+    else offset = run_end<g>(text, offset + 1, current);
+    if (variable && offset > start + 1) {
+      out << "<span class=\"identifier\">";
+      escape_code(out, text.substr(start, offset - start));
+      out << "</span>";
+      start = offset;
+    } else if (offset < text.size()) {
+      flush_token<g>(out, current, text.substr(start, offset - start));
+    }
+  }
+  flush_token<g>(out, current, text.substr(start, offset - start));
+}
+
+void highlight(Sink& out, std::string_view text, std::string_view language) {
+  STATS_SCOPE(scope, Phase::Highlight, out);
+  if (language.empty() || language == "cpp" || language == "c++" || language == "c" || language == "h") scan<cpp_grammar>(out, text);
+  else if (language == "cmake") scan<cmake_grammar>(out, text);
+  else if (language == "sh" || language == "bash" || language == "shell" || language == "console") scan<shell_grammar>(out, text);
+  else scan<text_grammar>(out, text);
+}
@@ -0,0 +1,9 @@
+#pragma once
+
+#include "sink.h"
+#include <string_view>
+
+// Writes text as syntax-highlighted HTML into out, using the grammar for language: the word after
+// a code fence. "cpp" (also "c++", "c", "h" and no language), "cmake", "sh" (also "bash", "shell",
+// "console") and "text" are known; any other language is written as plain text.
+void highlight(Sink& out, std::string_view text, std::string_view language = "cpp");
@@ -0,0 +1,108 @@
+#include "highlight_cache.h"
+#include "highlight.h"
+#include "hash.h"
+#include "html.h"
+#include <cstdio>
+
+// Bump when the file format changes. The renderer's fingerprint, which covers highlight() too, is
+// saved along with it, so entries from another highlighter are not reused either.
+static constexpr std::string_view highlight_cache_version = "fiets-highlight-3";
+
+static std::string version_line() {
+  char line[64];
+  snprintf(line, sizeof(line), "%s %016llx\n", highlight_cache_version.data(), (unsigned long long)renderer_fingerprint());
+  return line;
+}
+
+// Below this size highlighting is cheaper than hashing and locking.
+constexpr size_t min_cached_size = 64;
+
+// The language's length goes in too, or ("sh", "ow()") and ("", "show()") would share a key.
+static uint64_t key_for(std::string_view language, std::string_view text) {
+  return hash(text, hash(uint64_t(language.size()), hash(language)));
+}
+
+void HighlightCache::highlight(Sink& out, std::string_view text, std::string_view language) {
+  if (text.size() < min_cached_size) {
+    ::highlight(out, text, language);
+    return;
+  }
+  uint64_t key = key_for(language, text);
+  std::shared_ptr<const Snippet> snippet;
+  {
+    std::lock_guard<std::mutex> lock(mutex);
+    auto it = index.find(key);
+    // A colliding entry stays; text that collides with it is highlighted every time instead.
+    if (it != index.end() && it->second->snippet->text == text && it->second->snippet->language == language) {
+      order.splice(order.begin(), order, it->second);
+      snippet = it->second->snippet;
+      hits++;
+    } else {
+      misses++;
+    }
+  }
+  // The HTML is written outside the lock; the shared_ptr keeps it alive if it is evicted meanwhile.
+  if (snippet) {
+    out << snippet->html;
+    return;
+  }
+  std::string rendered;
+  StringSink sink(rendered);
+  ::highlight(sink, text, language);
+  out << rendered;
+  std::lock_guard<std::mutex> lock(mutex);
+  insert(key, std::make_shared<const Snippet>(Snippet{std::string(language), std::string(text), std::move(rendered)}));
+}
+
+void HighlightCache::insert(uint64_t key, std::shared_ptr<const Snippet> snippet) {
+  if (snippet->size() > capacity || index.count(key)) return;
+  used += snippet->size();
+  order.push_front(Entry{key, std::move(snippet)});
+  index[key] = order.begin();
+  while (used > capacity) {
+    used -= order.back().snippet->size();
+    index.erase(order.back().key);
+    order.pop_back();
+    evictions++;
+  }
+}
+
+// A version line, then per entry its key and the sizes of its language, text and HTML in hex on
+// one line, followed by the three; least recently used first, so loading restores the order.
+void HighlightCache::load(const std::filesystem::path& file) {
+  FILE* in = fopen(file.c_str(), "rb");
+  if (!in) return;
+  char version[64];
+  if (fgets(version, sizeof(version), in) && version == version_line()) {
+    std::lock_guard<std::mutex> lock(mutex);
+    unsigned long long key, sizes[3];
+    while (fscanf(in, "%llx %llx %llx %llx", &key, &sizes[0], &sizes[1], &sizes[2]) == 4 && fgetc(in) == '\n' &&
+           sizes[0] + sizes[1] + sizes[2] <= capacity) {
+      Snippet snippet;
+      std::string* parts[] = { &snippet.language, &snippet.text, &snippet.html };
+      bool complete = true;
+      for (size_t n = 0; n < 3 && complete; n++) {
+        parts[n]->resize(sizes[n]);
+        complete = fread(parts[n]->data(), 1, sizes[n], in) == sizes[n];
+      }
+      if (!complete) break;
+      // An entry whose text does not hash to its key is damaged; the rest of the file is not trusted.
+      if (key_for(snippet.language, snippet.text) != key) break;
+      insert(key, std::make_shared<const Snippet>(std::move(snippet)));
+    }
+  }
+  fclose(in);
+}
+
+void HighlightCache::save(const std::filesystem::path& file) {
+  std::lock_guard<std::mutex> lock(mutex);
+  FileSink out(file);
+  out << version_line();
+  char line[80];
+  for (auto it = order.rbegin(); it != order.rend(); ++it) {
+    const Snippet& s = *it->snippet;
+    snprintf(line, sizeof(line), "%llx %zx %zx %zx\n", (unsigned long long)it->key, s.language.size(), s.text.size(), s.html.size());
+    out << line << s.language << s.text << s.html;
+  }
+  if (!out.close()) fprintf(stderr, "Cannot write %s\n", file.c_str());
+}
@@ -0,0 +1,42 @@
+#pragma once
+
+#include "sink.h"
+#include <cstdint>
+#include <filesystem>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+
+// Highlighted HTML for code seen before, found by a hash of language and text, so snippets
+// repeated across blocks and papers are tokenised once. Safe to share between threads. Holds at
+// most capacity bytes of source and HTML and drops the least recently used entries beyond that.
+struct HighlightCache {
+  explicit HighlightCache(size_t capacity = 32 << 20) : capacity(capacity) {}
+  // Same output as highlight(out, text, language).
+  void highlight(Sink& out, std::string_view text, std::string_view language);
+  // Adds the entries saved in file, unless it is missing or from another highlighter version.
+  void load(const std::filesystem::path& file);
+  void save(const std::filesystem::path& file);
+  size_t hits = 0, misses = 0, evictions = 0;
+  size_t entries() const { return index.size(); }
+  size_t bytes() const { return used; }
+private:
+  // The source is kept with the HTML, so a hash collision is a miss rather than another snippet's code.
+  struct Snippet {
+    std::string language, text, html;
+    size_t size() const { return language.size() + text.size() + html.size(); }
+  };
+  struct Entry {
+    uint64_t key;
+    std::shared_ptr<const Snippet> snippet;
+  };
+  void insert(uint64_t key, std::shared_ptr<const Snippet> snippet);
+  size_t capacity, used = 0;
+  // Most recently used first.
+  std::list<Entry> order;
+  std::unordered_map<uint64_t, std::list<Entry>::iterator> index;
+  std::mutex mutex;
+};
@@ -1,453 +1,249 @@
 #include "html.h"
-#include <type_traits>
-#include <map>
-#include <unordered_set>
-
-std::unordered_set<std::string> keywords = {
-  "alignas", "alignof", "and_eq", "and", "asm", "auto", "bitand", "bitor", "bool", "break",
-  "case", "catch", "char8_t", "char16_t", "char32_t", "char", "class", "compl", "contract_assert", "const_cast",
-  "constexpr", "consteval", "constinit", "const", "continue", "decltype", "default", "delete", "do", "double",
-  "dynamic_cast", "else", "enum", "explicit", "extern", "false", "final", "float", "for",
-  "friend", "goto", "if", "inline", "int", "long", "mutable", "namespace", "new", "noexcept",
-  "not_eq", "not", "nullptr", "operator", "or_eq", "or", "override", "pre", "post", "private", "protected",
-  "public", "register", "reinterpret_cast", "return", "short", "signed", "sizeof",
-  "static_assert", "static_cast", "static", "struct", "switch", "template", "this",
-  "thread_local", "throw", "true", "try", "typedef", "typeid", "typename", "union",
-  "unsigned", "using", "virtual", "void", "volatile", "wchar_t", "while", "xor_eq", "xor",
-};
-
-std::map<char, std::string> replacements = {
-  { '<', "&lt;" },
-  { '>', "&gt;" },
-  { '&', "&amp;" },
-};
-
-enum CharacterType {
-  Alnum = 0,
-  Space = 1,
-  Special = 2,
-  Control = 3,
-  Other = 4,
-  Escape = 5,
-};
-
-CharacterType GetCharacterType(char8_t ch) {
-  if (replacements.contains(ch)) return CharacterType::Escape;
-  if (ch == 0x08 || ch == 0x0a || ch == 0x0d || ch == 0x20) return CharacterType::Space;
-  if (ch >= 0x80) return CharacterType::Other;
-  if (ch == 0x7F || ch < 0x20) return CharacterType::Control;
-  if ((ch >= '0' && ch <= '9') ||
-      (ch >= 'a' && ch <= 'z') ||
-      (ch >= 'A' && ch <= 'Z') ||
-      ch == '_') return CharacterType::Alnum;
-  return CharacterType::Special;
-}
-
-extern std::string html_header1, html_header2, html_footer;
-
-static const Document* doc = nullptr;
-
-std::string as_html(const Text& l);
-std::string as_html(const Insertion& i) {
-  return "<span class=\"new\">" + as_html(i.text) + "</span>";
-}
-
-std::string as_html(const Deletion& i) {
-  return "<span class=\"delete\">" + as_html(i.text) + "</span>";
-}
-
-std::string as_html(const Reference& i) {
-  return "<a href=\"" + doc->references[i.index-1].url + "\">" + doc->references[i.index-1].name + "</a>";
-}
-
-std::string as_html(const Quote& i) {
-  std::string rv = "<p class=\"quote\">";
-  for (auto& q : i.texts) {
-    rv += as_html(q);
-  }
-  rv += "</p>";
-  return rv;
-}
-
-std::string as_html(const Identifier& i) {
-  return "<span class=\"identifier\">" + std::string(i.text) + "</span>";
-}
-
-enum state {
-  Gathering,
-  CommentEOL,
-  CommentBlock
-};
-
-std::string highlight(std::string_view text) {
-  std::string output;
-  CharacterType current = CharacterType::Control;
-  std::string accum;
-  state s = Gathering;
-  for (auto& c : text) {
-    switch(s) {
-    case Gathering:
-      if (GetCharacterType(c) != current) {
-        if (not accum.empty()) {
-          switch(current) {
-          case CharacterType::Alnum:
-            if (keywords.contains(accum)) {
-              output += "<span class=\"keyword\">" + accum + "</span>";
-            } else {
-              output += accum;
-            }
-            break;
-          case CharacterType::Space:
-            output += accum;
-            break;
-          case CharacterType::Escape:
-            output += "<span class=\"special\">";
-            for (auto& ch : accum) {
-              output += replacements[ch];
-            }
-            output += "</span>";
-            break;
-          case CharacterType::Other:
-            output += accum;
-            break;
-          case CharacterType::Special:
-            output += "<span class=\"special\">" + accum + "</span>";
-            break;
-          case CharacterType::Control:
-            // Should nevr happen. Maybe transcode?
-            output += accum;
-            break;
-          }
-          accum.clear();
-        }
-      }
-      current = GetCharacterType(c);
-      accum.push_back(c);
-      break;
-    case CommentEOL:
-      if (c == '\n') {
-        s = Gathering;
-        output += "<span class=\"comment\">" + accum + "</span><br>";
-        accum.clear();
-      } else {
-        accum.push_back(c);
-      }
-      break;
-    case CommentBlock:
-      accum.push_back(c);
-      if (accum.ends_with("*/")) {
-        s = Gathering;
-        output += "<span class=\"comment\">" + accum + "</span><br>";
-        accum.clear();
-      }
-      break;
-    }
-    if (accum == "//") {
-      s = CommentEOL;
-    } else if (accum == "/*") {
-      s = CommentBlock;
-    }
+#include "hash.h"
+#include "highlight.h"
+#include "escape.h"
+#include "html_page.h"
+
+// Bump when a renderer change alters the generated HTML, so cached outputs get rebuilt.
+static constexpr std::string_view renderer_version = "fiets-html-4";
+
+// Computed at compile time, since every cached fragment's key starts from it.
+static constexpr uint64_t renderer_hash = hash(html_footer, hash(html_header2, hash(html_header1, hash(renderer_version))));
+
+uint64_t renderer_fingerprint() {
+  return renderer_hash;
+}
+
+// What a chapter fragment depends on besides its own source: the table of contents and the
+// reference list when it contains those, and the (first-seen) target of each link in it.
+static uint64_t toc_hash(const Chapter& ch, uint64_t h) {
+  for (auto& sub : ch.subchapters) h = toc_hash(sub, hash(sub.title, hash(sub.subchapters.size(), h)));
+  return h;
+}
+
+static uint64_t link_hash(const Document& doc, const Text& text, uint64_t h) {
+  for (auto& e : text.seq) {
+    if (auto* r = std::get_if<Reference>(&e)) h = hash(doc.references[r->index-1].name, hash(doc.references[r->index-1].url, h));
+    else if (auto* i = std::get_if<Insertion>(&e)) h = link_hash(doc, i->text, h);
+    else if (auto* d = std::get_if<Deletion>(&e)) h = link_hash(doc, d->text, h);
   }
-  switch(current) {
-  case CharacterType::Alnum:
-    if (keywords.contains(accum)) {
-      output += "<span class=\"keyword\">" + accum + "</span>";
-    } else {
-      output += accum;
-    }
-    break;
-  case CharacterType::Space:
-    output += accum;
-    break;
-  case CharacterType::Escape:
-    output += "<span class=\"special\">";
-    for (auto& ch : accum) {
-      output += replacements[ch];
+  return h;
+}
+
+static uint64_t fingerprint(const Document& doc, uint64_t toc, uint64_t references, const OutlineEntry& entry) {
+  const Chapter& ch = *entry.chapter;
+  uint64_t h = hash(entry.anchor, hash(entry.number, hash(ch.contentHash, hash(size_t(ch.level), renderer_hash))));
+  for (auto& el : ch.entries) {
+    if (std::holds_alternative<TOC>(el)) h = hash(toc, h);
+    else if (std::holds_alternative<References>(el)) h = hash(references, h);
+    else if (auto* t = std::get_if<Text>(&el)) h = link_hash(doc, *t, h);
+    else if (auto* l = std::get_if<List>(&el)) for (auto& t : l->entries) h = link_hash(doc, t, h);
+    else if (auto* l = std::get_if<OrderedList>(&el)) for (auto& t : l->entries) h = link_hash(doc, t, h);
+    else if (auto* q = std::get_if<Quote>(&el)) for (auto& t : q->texts) h = link_hash(doc, t, h);
+    else if (auto* d = std::get_if<IdentifierDefinition>(&el)) h = link_hash(doc, d->definition, h);
+    else if (auto* t = std::get_if<Table>(&el)) for (auto& row : t->entries) for (auto& cell : row) h = link_hash(doc, cell, h);
+  }
+  return h;
+}
+
+HtmlBackend::HtmlBackend(Sink& out, FragmentCache* cache, HighlightCache* highlights)
+: final(out)
+, out(&out)
+, cache(cache)
+, highlights(highlights)
+, fragmentOut(fragment)
+{}
+
+void HtmlBackend::highlight(std::string_view text, std::string_view language) {
+  if (highlights) highlights->highlight(*out, text, language);
+  else ::highlight(*out, text, language);
+}
+
+void HtmlBackend::beginDocument(const Document& doc, const std::vector<OutlineEntry>& outline) {
+  this->doc = &doc;
+  this->outline = &outline;
+  inChapters = false;
+  if (cache) {
+    tocKey = toc_hash(doc, 0);
+    referencesKey = 0;
+    for (auto& ref : doc.references) referencesKey = hash(ref.name, hash(ref.url, referencesKey));
+    cache->reused = cache->rendered = 0;
+    used.clear();
+  }
+  *out << html_header1 << Escaped{doc.title} << html_header2;
+  *out << "<h1 class=\"title\" style=\"text-align:center\">" << Escaped{doc.title} << "</h1>";
+  if (!doc.subtitle.empty()) 
+    *out << "<h2 class=\"subtitle\" style=\"text-align:center\">" << Escaped{doc.subtitle} << "</h2>";
+}
+
+void HtmlBackend::endDocument() {
+  *out << html_footer;
+  if (cache) cache->fragments = std::move(used);
+}
+
+// A chapter's heading and own entries form one fragment. With a cache, a fragment rendered before
+// is copied out and its entries are skipped; a new one is rendered aside and then stored.
+bool HtmlBackend::beginChapter(const OutlineEntry& entry) {
+  inChapters = true;
+  if (cache) {
+    fragmentKey = fingerprint(*doc, tocKey, referencesKey, entry);
+    auto it = cache->fragments.find(fragmentKey);
+    if (it != cache->fragments.end()) {
+      cache->reused++;
+      *out << it->second;
+      used.insert(cache->fragments.extract(it));
+      return false;
     }
-    output += "</span>";
-    break;
-  case CharacterType::Other:
-    output += accum;
-    break;
-  case CharacterType::Special:
-    output += "<span class=\"special\">" + accum + "</span>";
-    break;
-  case CharacterType::Control:
-    // Should nevr happen. Maybe transcode?
-    output += accum;
-    break;
+    cache->rendered++;
+    fragment.clear();
+    out = &fragmentOut;
   }
-  return output;
+  const Chapter& ch = *entry.chapter;
+  *out << "<h" << size_t(ch.level) << " data-number=\"" << entry.number << "\" id=\"" << entry.anchor << "\"><span class=\"header-section-number\">" << entry.number << "</span> " << Escaped{ch.title} << "<a href=\"#" << entry.anchor << "\" class=\"self-link\"></a></h" << size_t(ch.level) << ">";
+  return true;
 }
 
-std::string as_html(const CodeSpan& i) {
-  return "<span class=\"code\">" + highlight(i.text) + "</span>";
+void HtmlBackend::endChapter(const OutlineEntry&) {
+  if (out != &fragmentOut) return;
+  out = &final;
+  *out << fragment;
+  used.emplace(fragmentKey, std::move(fragment));
 }
 
-std::string as_html(const std::string& s) {
-  std::string copy = s;
-  size_t offs = copy.find_first_of("<>");
-  while (offs != std::string::npos) {
-    copy = copy.substr(0, offs) + (copy[offs] == '<' ? "&lt;" : "&gt;") + copy.substr(offs+1);
-    offs = copy.find_first_of("<>");
-  }
-  return copy;
+// Text before the first chapter is not put in paragraphs.
+void HtmlBackend::beginParagraph() {
+  if (inChapters) *out << "<p>";
 }
 
-std::string as_html(const References&) {
-  std::string accum = "<ol>";
-  for (auto ref : doc->references) {
-    accum += "<li id=\"#ref-" + std::to_string(ref.index) + "\"><a href=\"" + ref.url + "\">" + ref.name + " (" + ref.url + ")</a></li>";
-  }
-  accum += "</ol>";
-  return accum;
+void HtmlBackend::endParagraph() {
+  if (inChapters) *out << "</p>";
 }
 
-static std::string as_id(std::string_view name) {
-  std::string id(name);
-  size_t pos = id.find_first_not_of("abcdefghijklmnopqrstuvwxyzABCDEFGHIJKLMNOPQRSTUVWXYZ0123456789_-");
-  while (pos != std::string::npos) {
-    if (id[pos] == '+') id[pos] = 'p';
-    else id[pos] = '-';
-    pos = id.find_first_not_of("abcdefghijklmnopqrstuvwxyzABCDEFGHIJKLMNOPQRSTUVWXYZ0123456789_-");
-  }
-  return id;
+void HtmlBackend::beginList(bool ordered) {
+  *out << (ordered ? "<ol>" : "<ul>");
 }
 
-std::string as_html_toc(const Chapter& chap, std::string prefix, size_t size) {
-  std::string accum;
-  accum += "<h" + std::to_string(size) + " class=\"toc\"><a href=\"#" + as_id(chap.title) + "\">" + prefix + " " + std::string(chap.title) + "</a></h" + std::to_string(size) + ">";
-  for (size_t n = 0; n < chap.subchapters.size(); n++) {
-    accum += as_html_toc(chap.subchapters[n], prefix + "." + std::to_string(n + 1), 3);
-  }
-  return accum;
+void HtmlBackend::endList(bool ordered) {
+  *out << (ordered ? "</ol>" : "</ul>");
 }
 
-std::string as_html(const TOC&) {
-  std::string accum;
-  accum += "<h1 class=\"toc\">Table of contents</h1>";
-  for (size_t n = 0; n < doc->subchapters.size(); n++) {
-    accum += as_html_toc(doc->subchapters[n], std::to_string(n + 1), 2);
-  }
-  return accum;
+void HtmlBackend::beginListItem() {
+  *out << "<li>";
 }
 
-std::string as_html(const Text& l) {
-  std::string accum;
-  for (auto& e : l.seq) {
-    accum += std::visit([](const auto& ee) { return as_html(ee); }, e);
-  }
-  return accum;
+void HtmlBackend::endListItem() {
+  *out << "</li>";
 }
 
-std::string as_html(const Code& c) {
-  return "<code><div class=\"code\">" + highlight(c.body) + "</div></code>";
+void HtmlBackend::beginQuote() {
+  *out << "<p class=\"quote\">";
 }
 
-std::string as_html(const List& l) {
-  std::string accum = "<ul>";
-  for (auto& item : l.entries) {
-    accum += "<li>" + as_html(item) + "</li>";
-  }
-  return accum + "</ul>";
+void HtmlBackend::endQuote() {
+  *out << "</p>";
 }
 
-std::string as_html(const OrderedList& l) {
-  std::string accum = "<ol>";
-  for (auto& item : l.entries) {
-    accum += "<li>" + as_html(item) + "</li>";
-  }
-  return accum + "</ol>";
+void HtmlBackend::beginTable() {
+  *out << "<table>";
+  tableBody = false;
 }
 
-std::string as_html(const IdentifierDefinition&) {
-   return "TODO";
+void HtmlBackend::endTable() {
+  if (!tableBody) *out << "<tbody>";
+  *out << "</tbody></table>";
 }
 
-std::string as_html(const Table& l) {
-  bool has_header = true;
-  if (l.entries.size() < 3) has_header = false;
-  else {
-    for (auto& v : l.entries[1]) 
-      if (v.seq.size() != 1) has_header = false;
-      else if (!std::holds_alternative<std::string>(v.seq[0])) has_header = false;
-      else if (std::get<std::string>(v.seq[0]) != "-") has_header = false;
-  }
-  std::string accum = "<table>";
-  size_t n = 0;
-  if (has_header) {
-     accum += "<thead><tr>";
-    for (auto& e : l.entries[n]) {
-      accum += "<th>" + as_html(e) + "</th>";
-    }
-    accum += "</tr></thead>";
-    n = 2;
+void HtmlBackend::beginRow(bool header) {
+  if (header) {
+    *out << "<thead><tr>";
+    return;
   }
-  accum += "<tbody>";
-  for (;n < l.entries.size(); n++) {
-    accum += "<tr>";
-    for (auto& e : l.entries[n]) {
-      accum += "<td>" + as_html(e) + "</td>";
-    }
-    accum += "</tr>";
-  } 
-  accum += "</tbody></table>";
-  return accum;
+  if (!tableBody) *out << "<tbody>";
+  tableBody = true;
+  *out << "<tr>";
 }
 
-std::string as_html(std::string name, const Chapter& ch) {
-  std::string accum;
-  accum += "<h" + std::to_string(ch.level) + " data-number=\"" + std::string(name) + "\" id=\"" + as_id(ch.title) + "\"><span class=\"header-section-number\">" + name + "</span> " + std::string(ch.title) + "<a href=\"#" + as_id(ch.title) + "\" class=\"self-link\"></a></h" + std::to_string(ch.level) + ">";
-  for (auto& el : ch.entries) {
-    accum += std::visit([](auto e){ 
-      if constexpr (std::is_same_v<std::remove_cvref_t<decltype(e)>, Text>) {
-        return "<p>" + as_html(e) + "</p>";
-      } else { 
-        return as_html(e); 
-      }
-    }, el);
-  }
+void HtmlBackend::endRow(bool header) {
+  *out << (header ? "</tr></thead>" : "</tr>");
+}
 
-  for (size_t n = 0; n < ch.subchapters.size(); n++) {
-    accum += as_html(name + "." + std::to_string(n+1), ch.subchapters[n]);
-  }
+void HtmlBackend::beginCell(bool header) {
+  *out << (header ? "<th>" : "<td>");
+}
 
-  return accum;
+void HtmlBackend::endCell(bool header) {
+  *out << (header ? "</th>" : "</td>");
 }
 
-std::string as_html(const Document& ch) {
-  doc = &ch;
-  std::string accumulator = html_header1;
-  accumulator.reserve(400000);
-  accumulator += ch.title;
-  accumulator += html_header2;
-  accumulator += "<h1 class=\"title\" style=\"text-align:center\">" + std::string(ch.title) + "</h1>";
-  if (!ch.subtitle.empty()) 
-    accumulator += "<h2 class=\"subtitle\" style=\"text-align:center\">" + std::string(ch.subtitle) + "</h2>";
+bool HtmlBackend::beginDefinition(std::string_view) {
+  *out << "TODO";
+  return false;
+}
 
-  for (auto& el : ch.entries) {
-    accumulator += std::visit([](auto e){ return as_html(e); }, el);
+void HtmlBackend::code(const Code& c) {
+  *out << "<code><div class=\"code\">";
+  highlight(c.body, c.language);
+  *out << "</div></code>";
+}
+
+void HtmlBackend::toc() {
+  *out << "<h1 class=\"toc\">Table of contents</h1>";
+  for (auto& entry : *outline) {
+    size_t size = entry.depth == 1 ? 2 : 3;
+    *out << "<h" << size << " class=\"toc\"><a href=\"#" << entry.anchor << "\">" << entry.number << " " << Escaped{entry.chapter->title} << "</a></h" << size << ">";
   }
+}
 
-  size_t n = 1;
-  for (auto& subch : ch.subchapters) {
-    accumulator += as_html(std::to_string(n), subch);
-    n++;
+void HtmlBackend::references() {
+  *out << "<ol>";
+  for (auto& ref : doc->references) {
+    *out << "<li id=\"#ref-" << size_t(ref.index) << "\"><a href=\"" << Escaped{ref.url} << "\">" << Escaped{ref.name} << " (" << Escaped{ref.url} << ")</a></li>";
   }
+  *out << "</ol>";
+}
 
-  accumulator += html_footer;
-  doc = nullptr;
-  return accumulator;
+void HtmlBackend::text(std::string_view s) {
+  escape_html(*out, s);
+}
+
+void HtmlBackend::beginInsertion() {
+  *out << "<span class=\"new\">";
+}
+
+void HtmlBackend::endInsertion() {
+  *out << "</span>";
+}
+
+void HtmlBackend::beginDeletion() {
+  *out << "<span class=\"delete\">";
 }
 
-std::string html_header1 = 
-  "<!DOCTYPE html>\n"
-  "<html xmlns=\"http://www.w3.org/1999/xhtml\">\n"
-  "<head>\n"
-  "<meta http-equiv=\"content-type\" content=\"text/html; charset=UTF-8\">\n"
-  "<meta charset=\"utf-8\">\n"
-  "<meta name=\"generator\" content=\"dascandy/fiets\">\n"
-  "<title>\n"
-
-, html_header2 = 
-  "</title>\n"
-  "  <style type=\"text/css\">\n"
-  "body {\n"
-  "  margin: 5em;\n"
-  "  font-family: sans-serif;\n"
-  "  hyphens: auto;\n"
-  "  line-height: 1.35;\n"
-  "}\n"
-  "ul {\n"
-  "  padding-left: 2em;\n"
-  "}\n"
-  "h1, h2, h3, h4 {\n"
-  "  position: relative;\n"
-  "  line-height: 1;\n"
-  "}\n"
-  "h1.title {\n"
-  "}\n"
-  "h2.subtitle {\n"
-  "}\n"
-  "h1.toc a, h2.toc a, h3.toc a, h4.toc a {\n"
-  "  text-decoration: none;\n"
-  "  color: #000000;\n"
-  "}\n"
-  "h1.toc a:hover, h2.toc a:hover, h3.toc a:hover, h4.toc a:hover {\n"
-  "  text-decoration: underline;\n"
-  "}\n"
-  "a.self-link {\n"
-  "  position: absolute;\n"
-  "  top: 0;\n"
-  "  left: calc(-1 * (3.5rem - 26px));\n"
-  "  width: calc(3.5rem - 26px);\n"
-  "  height: 2em;\n"
-  "  text-align: center;\n"
-  "  border: none;\n"
-  "  transition: opacity .2s;\n"
-  "  opacity: .5;\n"
-  "  font-family: sans-serif;\n"
-  "  font-weight: normal;\n"
-  "  font-size: 83%;\n"
-  "}\n"
-  "a.self-link:hover { opacity: 1; }\n"
-  "a.self-link::before { content: \"§\"; }\n"
-  "span.identifier {\n"
-  "  font-style: italic;\n"
-  "}\n"
-  "span.special {\n"
-  "  color: #bf003f;\n"
-  "}\n"
-  "span.keyword {\n"
-  "  color: #0030cf;\n"
-  "}\n"
-  "span.comment {\n"
-  "  color: #00c000;\n"
-  "}\n"
-  "span.new {\n"
-  "  text-decoration: underline;\n"
-  "  background-color: #00ff40;\n"
-  "}\n"
-  "div.code, span.code {\n"
-  "  font-family: Courier New, monospace;\n"
-  "  background-color: #e8e8e8;\n"
-  "  white-space: pre;\n"
-  "}\n"
-  "span.delete {\n"
-  "  text-decoration: line-through;\n"
-  "  background-color: #bf0303;\n"
-  "}\n"
-  "p.indent {\n"
-  "  margin-left: 50px;\n"
-  "}\n"
-  "p.quote {\n"
-  "  margin-left: 50px;\n"
-  "  border: 2px solid black;\n"
-  "  background-color: #f0f0e0;\n"
-  "}\n"
-  "table {\n"
-  "  border: 1px solid black;\n"
-  "  border-collapse: collapse;\n"
-  "  margin-left: auto;\n"
-  "  margin-right: auto;\n"
-  "  margin-top: 0.8em;\n"
-  "  text-align: left;\n"
-  "  hyphens: none; \n"
-  "}\n"
-  "td, th {\n"
-  "  padding-left: 1em;\n"
-  "  padding-right: 1em;\n"
-  "  vertical-align: top;\n"
-  "}\n"
-  "th {\n"
-  "  border-bottom: 2px solid black;\n"
-  "  background-color: #f0f0f0;\n"
-  "}\n"
-  "</style>\n"
-  "</head>\n"
-  "<body>\n"
-;
-
-std::string html_footer = "</body></html>\n";
+void HtmlBackend::endDeletion() {
+  *out << "</span>";
+}
 
+void HtmlBackend::reference(const Referenced& ref) {
+  *out << "<a href=\"" << Escaped{ref.url} << "\">" << Escaped{ref.name} << "</a>";
+}
+
+void HtmlBackend::identifier(std::string_view id) {
+  *out << "<span class=\"identifier\">" << Escaped{id} << "</span>";
+}
 
+void HtmlBackend::codeSpan(std::string_view code) {
+  *out << "<span class=\"code\">";
+  highlight(code, "cpp");
+  *out << "</span>";
+}
+
+void as_html(Sink& out, const Document& doc, FragmentCache* cache, HighlightCache* highlights) {
+  HtmlBackend html(out, cache, highlights);
+  render(doc, {&html});
+}
+
+std::string as_html(const Document& doc) {
+  std::string accumulator;
+  StringSink out(accumulator);
+  as_html(out, doc);
+  return accumulator;
+}
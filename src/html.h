@@ -1,6 +1,77 @@
 #pragma once
 
 #include "parser.h"
+#include "backend.h"
+#include "highlight_cache.h"
+#include "sink.h"
+#include <cstdint>
 
-std::string as_html(const Document& ch);
+#include <string>
+#include <unordered_map>
+
+// Rendered HTML of each chapter's heading and own entries, keyed on a fingerprint of everything
+// that output depends on. Passing the same cache to successive renders of a paper re-renders only
+// the chapters that changed; fragments not used by the latest render are dropped.
+struct FragmentCache {
+  // Counts for the latest render.
+  size_t reused = 0, rendered = 0;
+  std::unordered_map<uint64_t, std::string> fragments;
+};
+
+// Writes a paper as a standalone HTML page. Code is highlighted through highlights when given.
+struct HtmlBackend : Backend {
+  HtmlBackend(Sink& out, FragmentCache* cache = nullptr, HighlightCache* highlights = nullptr);
+  size_t written() const override { return final.written() + (out == &fragmentOut ? fragmentOut.written() : 0); }
+  void beginDocument(const Document& doc, const std::vector<OutlineEntry>& outline) override;
+  void endDocument() override;
+  bool beginChapter(const OutlineEntry& entry) override;
+  void endChapter(const OutlineEntry& entry) override;
+  void beginParagraph() override;
+  void endParagraph() override;
+  void beginList(bool ordered) override;
+  void endList(bool ordered) override;
+  void beginListItem() override;
+  void endListItem() override;
+  void beginQuote() override;
+  void endQuote() override;
+  void beginTable() override;
+  void endTable() override;
+  void beginRow(bool header) override;
+  void endRow(bool header) override;
+  void beginCell(bool header) override;
+  void endCell(bool header) override;
+  bool beginDefinition(std::string_view identifier) override;
+  void code(const Code& code) override;
+  void toc() override;
+  void references() override;
+  void text(std::string_view text) override;
+  void beginInsertion() override;
+  void endInsertion() override;
+  void beginDeletion() override;
+  void endDeletion() override;
+  void reference(const Referenced& ref) override;
+  void identifier(std::string_view identifier) override;
+  void codeSpan(std::string_view code) override;
+private:
+  Sink& final;
+  // final, or fragmentOut while a chapter is rendered into the cache.
+  Sink* out;
+  FragmentCache* cache;
+  HighlightCache* highlights;
+  const Document* doc = nullptr;
+  const std::vector<OutlineEntry>* outline = nullptr;
+  bool inChapters = false, tableBody = false;
+  // Hashes of the table of contents and the reference list, which fragments containing them depend on.
+  uint64_t tocKey = 0, referencesKey = 0, fragmentKey = 0;
+  std::string fragment;
+  StringSink fragmentOut;
+  std::unordered_map<uint64_t, std::string> used;
+  void highlight(std::string_view text, std::string_view language);
+};
+
+void as_html(Sink& out, const Document& doc, FragmentCache* cache = nullptr, HighlightCache* highlights = nullptr);
+std::string as_html(const Document& doc);
+
+// Identifies the renderer's output format; changes whenever the code or the page template does.
+uint64_t renderer_fingerprint();
 
@@ -0,0 +1,114 @@
+#pragma once
+
+#include <string_view>
+
+// The page around a rendered paper: html_header1, the escaped title, html_header2 with the
+// stylesheet, the body, then html_footer.
+inline constexpr std::string_view html_header1 =
+  "<!DOCTYPE html>\n"
+  "<html xmlns=\"http://www.w3.org/1999/xhtml\">\n"
+  "<head>\n"
+  "<meta http-equiv=\"content-type\" content=\"text/html; charset=UTF-8\">\n"
+  "<meta charset=\"utf-8\">\n"
+  "<meta name=\"generator\" content=\"dascandy/fiets\">\n"
+  "<title>\n";
+
+inline constexpr std::string_view html_header2 =
+  "</title>\n"
+  "  <style type=\"text/css\">\n"
+  "body {\n"
+  "  margin: 5em;\n"
+  "  font-family: sans-serif;\n"
+  "  hyphens: auto;\n"
+  "  line-height: 1.35;\n"
+  "}\n"
+  "ul {\n"
+  "  padding-left: 2em;\n"
+  "}\n"
+  "h1, h2, h3, h4 {\n"
+  "  position: relative;\n"
+  "  line-height: 1;\n"
+  "}\n"
+  "h1.title {\n"
+  "}\n"
+  "h2.subtitle {\n"
+  "}\n"
+  "h1.toc a, h2.toc a, h3.toc a, h4.toc a {\n"
+  "  text-decoration: none;\n"
+  "  color: #000000;\n"
+  "}\n"
+  "h1.toc a:hover, h2.toc a:hover, h3.toc a:hover, h4.toc a:hover {\n"
+  "  text-decoration: underline;\n"
+  "}\n"
+  "a.self-link {\n"
+  "  position: absolute;\n"
+  "  top: 0;\n"
+  "  left: calc(-1 * (3.5rem - 26px));\n"
+  "  width: calc(3.5rem - 26px);\n"
+  "  height: 2em;\n"
+  "  text-align: center;\n"
+  "  border: none;\n"
+  "  transition: opacity .2s;\n"
+  "  opacity: .5;\n"
+  "  font-family: sans-serif;\n"
+  "  font-weight: normal;\n"
+  "  font-size: 83%;\n"
+  "}\n"
+  "a.self-link:hover { opacity: 1; }\n"
+  "a.self-link::before { content: \"§\"; }\n"
+  "span.identifier {\n"
+  "  font-style: italic;\n"
+  "}\n"
+  "span.special {\n"
+  "  color: #bf003f;\n"
+  "}\n"
+  "span.keyword {\n"
+  "  color: #0030cf;\n"
+  "}\n"
+  "span.comment {\n"
+  "  color: #00c000;\n"
+  "}\n"
+  "span.new {\n"
+  "  text-decoration: underline;\n"
+  "  background-color: #00ff40;\n"
+  "}\n"
+  "div.code, span.code {\n"
+  "  font-family: Courier New, monospace;\n"
+  "  background-color: #e8e8e8;\n"
+  "  white-space: pre;\n"
+  "}\n"
+  "span.delete {\n"
+  "  text-decoration: line-through;\n"
+  "  background-color: #bf0303;\n"
+  "}\n"
+  "p.indent {\n"
+  "  margin-left: 50px;\n"
+  "}\n"
+  "p.quote {\n"
+  "  margin-left: 50px;\n"
+  "  border: 2px solid black;\n"
+  "  background-color: #f0f0e0;\n"
+  "}\n"
+  "table {\n"
+  "  border: 1px solid black;\n"
+  "  border-collapse: collapse;\n"
+  "  margin-left: auto;\n"
+  "  margin-right: auto;\n"
+  "  margin-top: 0.8em;\n"
+  "  text-align: left;\n"
+  "  hyphens: none; \n"
+  "}\n"
+  "td, th {\n"
+  "  padding-left: 1em;\n"
+  "  padding-right: 1em;\n"
+  "  vertical-align: top;\n"
+  "}\n"
+  "th {\n"
+  "  border-bottom: 2px solid black;\n"
+  "  background-color: #f0f0f0;\n"
+  "}\n"
+  "</style>\n"
+  "</head>\n"
+  "<body>\n";
+
+inline constexpr std::string_view html_footer = "</body></html>\n";
@@ -1,16 +1,308 @@
 #include <iostream>
 #include "parser.h"
 #include <filesystem>
-#include <fstream>
+#include <atomic>
+#include <thread>
+#include <vector>
+#include <string_view>
+#include <optional>
 #include "html.h"
+#include "plain_text.h"
+#include "markdown.h"
+#include "hash.h"
+#include "cache.h"
+#include "bench.h"
+#include "serve.h"
+#include "check.h"
+#include "ast_file.h"
+#include "stats.h"
+#include <mutex>
+#include <algorithm>
+#include <charconv>
 
-int main(int , char** argv) {
-  std::string body;
-  body.resize(std::filesystem::file_size(argv[1]));
-  std::ifstream(argv[1]).read(body.data(), body.size());
-  Document doc = parse(body);
-  std::string html = as_html(doc);
-  std::ofstream(argv[2]).write(html.data(), html.size());
+static std::unique_ptr<MappedFile> read(const std::filesystem::path& in) {
+  std::unique_ptr<MappedFile> source = MappedFile::open(in);
+  if (!source) fprintf(stderr, "Cannot read %s\n", in.c_str());
+  return source;
 }
 
+struct ParseStats {
+  std::atomic<size_t> documents = 0, allocations = 0, blocks = 0;
+};
+
+// Output formats, picked by file extension.
+static constexpr std::string_view formats[] = { ".html", ".txt", ".md" };
+
+static bool known_format(std::string_view extension) {
+  return std::find(std::begin(formats), std::end(formats), extension) != std::end(formats);
+}
+
+static std::unique_ptr<Backend> backend_for(const std::filesystem::path& out, Sink& sink, HighlightCache* highlights) {
+  if (out.extension() == ".txt") return std::make_unique<PlainTextBackend>(sink);
+  if (out.extension() == ".md") return std::make_unique<MarkdownBackend>(sink);
+  return std::make_unique<HtmlBackend>(sink, nullptr, highlights);
+}
+
+static uint64_t fingerprint_for(const std::filesystem::path& out) {
+  if (out.extension() == ".txt") return hash(plain_text_version);
+  if (out.extension() == ".md") return hash(markdown_version);
+  return renderer_fingerprint();
+}
+
+// Writes every output from a single walk over the tree.
+static bool render(const Document& doc, const std::vector<std::filesystem::path>& outs, ParseStats& stats, HighlightCache* highlights = nullptr) {
+  stats.documents++;
+  stats.allocations += doc.arena->allocations;
+  stats.blocks += doc.arena->blocks();
+  std::vector<std::unique_ptr<FileSink>> sinks;
+  std::vector<std::unique_ptr<Backend>> backends;
+  std::vector<Backend*> all;
+  for (auto& out : outs) {
+    sinks.push_back(std::make_unique<FileSink>(out));
+    backends.push_back(backend_for(out, *sinks.back(), highlights));
+    all.push_back(backends.back().get());
+  }
+  render(doc, all);
+  bool ok = true;
+  for (size_t n = 0; n < outs.size(); n++) {
+    if (!sinks[n]->close()) {
+      fprintf(stderr, "Cannot write %s\n", outs[n].c_str());
+      ok = false;
+    }
+  }
+  return ok;
+}
+
+struct BatchOptions {
+  bool useCache = true;
+  std::optional<std::filesystem::path> diagnosticsJson;
+  // Extensions of the outputs written per input; .html when none are given.
+  std::vector<std::string> formats;
+};
+
+// Renders every input (or every .fiets file in an input directory) into outdir, using one worker per core.
+// With fewer inputs than cores the remaining cores help parse large inputs.
+// Inputs whose outputs all have an unchanged source and renderer since the last run are skipped unless the cache is off.
+// Highlighted code is shared between all papers, and kept in the output directory along with the cache.
+static int batch(const std::filesystem::path& outdir, const std::vector<std::filesystem::path>& args, const BatchOptions& options) {
+  std::vector<std::filesystem::path> inputs;
+  for (auto& arg : args) {
+    if (std::filesystem::is_directory(arg)) {
+      for (auto& entry : std::filesystem::directory_iterator(arg)) {
+        if (entry.path().extension() == ".fiets") inputs.push_back(entry.path());
+      }
+    } else {
+      inputs.push_back(arg);
+    }
+  }
+  std::filesystem::create_directories(outdir);
+  std::optional<BuildCache> cache;
+  if (options.useCache) cache.emplace(outdir);
+  HighlightCache highlights;
+  std::filesystem::path highlightsFile = outdir / ".fiets-highlight";
+  if (options.useCache) highlights.load(highlightsFile);
+  std::vector<std::string> extensions = options.formats;
+  if (extensions.empty()) extensions.push_back(".html");
+  size_t cores = std::max(1u, std::thread::hardware_concurrency());
+  size_t parseThreads = inputs.empty() ? 1 : std::max<size_t>(1, cores / inputs.size());
+
+  std::atomic<size_t> next = 0;
+  std::atomic<size_t> failures = 0;
+  ParseStats stats;
+  std::mutex diagnosticsMutex;
+  std::vector<Diagnostics> diagnostics;
+  auto worker = [&] {
+    for (size_t n = next++; n < inputs.size(); n = next++) {
+      std::unique_ptr<MappedFile> source = read(inputs[n]);
+      if (!source) {
+        failures++;
+        continue;
+      }
+      std::vector<std::filesystem::path> outs;
+      std::vector<uint64_t> keys;
+      bool fresh = bool(cache);
+      for (auto& extension : extensions) {
+        outs.push_back(outdir / inputs[n].stem().concat(extension));
+        keys.push_back(hash(source->data(), fingerprint_for(outs.back())));
+        // Every format is looked up, so the hit and miss counts stay per output.
+        if (cache && !cache->fresh(outs.back(), keys.back())) fresh = false;
+      }
+      if (fresh) continue;
+      Diagnostics found;
+      found.file = inputs[n].string();
+      if (!render(parseParallel(std::move(source), parseThreads, &found), outs, stats, &highlights)) {
+        failures++;
+      } else if (cache) {
+        for (size_t k = 0; k < outs.size(); k++) cache->store(outs[k], keys[k]);
+      }
+      if (!found.entries.empty()) {
+        std::lock_guard<std::mutex> lock(diagnosticsMutex);
+        found.print(stderr);
+        diagnostics.push_back(std::move(found));
+      }
+    }
+  };
+  std::vector<std::thread> workers;
+  size_t count = std::min<size_t>(cores, inputs.size());
+  for (size_t n = 1; n < count; n++) workers.emplace_back(worker);
+  worker();
+  for (auto& t : workers) t.join();
+  if (cache) {
+    cache->save();
+    printf("cache: %zu hits, %zu misses\n", cache->hits, cache->misses);
+  }
+  if (options.useCache) highlights.save(highlightsFile);
+  if (highlights.hits + highlights.misses) {
+    printf("highlight: %zu hits, %zu misses (%.0f%% hit rate), %zu snippets in %zu KB, %zu evicted\n", highlights.hits, highlights.misses,
+           100.0 * highlights.hits / (highlights.hits + highlights.misses), highlights.entries(), highlights.bytes() >> 10, highlights.evictions);
+  }
+  if (stats.documents) {
+    printf("parse: %zu documents, %zu tree allocations in %zu arena blocks\n", stats.documents.load(), stats.allocations.load(), stats.blocks.load());
+  }
+  if (options.diagnosticsJson) {
+    FileSink out(*options.diagnosticsJson);
+    write_json(out, diagnostics);
+    if (!out.close()) {
+      fprintf(stderr, "Cannot write %s\n", options.diagnosticsJson->c_str());
+      failures++;
+    }
+  }
+  return failures ? 1 : 0;
+}
+
+// A TCP port, 1 to 65535.
+static std::optional<uint16_t> parse_port(std::string_view text) {
+  unsigned port = 0;
+  auto [end, ec] = std::from_chars(text.data(), text.data() + text.size(), port);
+  if (ec != std::errc() || end != text.data() + text.size() || port < 1 || port > 65535) return std::nullopt;
+  return uint16_t(port);
+}
+
+static int run(int argc, char** argv) {
+  if (argc >= 3 && argv[1] == std::string_view("--batch")) {
+    BatchOptions options;
+    int first = 2;
+    for (; first < argc && std::string_view(argv[first]).starts_with("--"); first++) {
+      if (argv[first] == std::string_view("--no-cache")) {
+        options.useCache = false;
+      } else if (argv[first] == std::string_view("--diagnostics-json") && first + 1 < argc) {
+        options.diagnosticsJson = argv[++first];
+      } else if (argv[first] == std::string_view("--format") && first + 1 < argc && known_format("." + std::string(argv[first + 1]))) {
+        options.formats.push_back("." + std::string(argv[++first]));
+      } else {
+        break;
+      }
+    }
+    if (argc > first && !std::string_view(argv[first]).starts_with("--")) {
+      return batch(argv[first], std::vector<std::filesystem::path>(argv + first + 1, argv + argc), options);
+    }
+  } else if ((argc == 3 || argc == 4) && argv[1] == std::string_view("--serve")) {
+    std::optional<uint16_t> port = argc == 4 ? parse_port(argv[3]) : 8080;
+    if (port) return serve(argv[2], *port);
+  } else if (argc == 2 && argv[1] == std::string_view("--bench-check")) {
+    return bench_check();
+  } else if (argc >= 2 && argv[1] == std::string_view("--bench")) {
+    BenchOptions options;
+    bool ok = true;
+    for (int n = 2; n < argc && ok; n++) {
+      std::string_view arg = argv[n];
+      if (!arg.starts_with("--")) {
+        if (std::filesystem::is_directory(arg)) {
+          for (auto& entry : std::filesystem::directory_iterator(arg)) {
+            if (entry.path().extension() == ".fiets") options.inputs.push_back(entry.path());
+          }
+        } else {
+          options.inputs.push_back(arg);
+        }
+      } else if (n + 1 >= argc) {
+        ok = false;
+      } else if (arg == "--synthetic-size") {
+        options.size = size_t(atof(argv[++n]) * (1 << 20));
+      } else if (arg == "--code") {
+        options.code = atof(argv[++n]);
+      } else if (arg == "--tables") {
+        options.tables = atof(argv[++n]);
+      } else if (arg == "--links") {
+        options.links = atof(argv[++n]);
+      } else if (arg == "--markup") {
+        options.markup = atof(argv[++n]);
+      } else if (arg == "--write-synthetic") {
+        options.writeSynthetic = argv[++n];
+      } else {
+        ok = false;
+      }
+    }
+    if (ok) return bench(options);
+  } else if ((argc == 4 || argc == 5) && argv[1] == std::string_view("--check")) {
+    bool update = argc == 5 && argv[2] == std::string_view("--update");
+    if (argc == 4 || update) return check(argv[argc - 2], argv[argc - 1], update);
+  } else if (argc == 4 && argv[1] == std::string_view("--save-ast")) {
+    std::unique_ptr<MappedFile> source = read(argv[2]);
+    if (!source) return 1;
+    Diagnostics diagnostics;
+    diagnostics.file = argv[2];
+    Document doc = parse(std::move(source), &diagnostics);
+    diagnostics.print(stderr);
+    if (!save(doc, argv[3])) {
+      fprintf(stderr, "Cannot write %s\n", argv[3]);
+      return 1;
+    }
+    return 0;
+  } else if (argc >= 3 && !std::string_view(argv[1]).starts_with("--")) {
+    // "-" reads the paper from stdin, parsing it as it arrives. Outputs that are not .txt or .md are HTML.
+    ParseStats stats;
+    Diagnostics diagnostics;
+    std::vector<std::filesystem::path> outs(argv + 2, argv + argc);
+    bool ok;
+    if (argv[1] == std::string_view("-")) {
+      diagnostics.file = "<stdin>";
+      ok = render(parse(stdin, &diagnostics), outs, stats) && !ferror(stdin);
+    } else {
+      std::unique_ptr<MappedFile> source = read(argv[1]);
+      diagnostics.file = argv[1];
+      ok = source && render(parseParallel(std::move(source), std::max(1u, std::thread::hardware_concurrency()), &diagnostics), outs, stats);
+    }
+    diagnostics.print(stderr);
+    return ok ? 0 : 1;
+  }
+  fprintf(stderr, "Usage: %s <input.fiets|-> <output.html|output.txt|output.md>...\n"
+                  "       %s --batch [--no-cache] [--diagnostics-json <file>] [--format html|txt|md]... <outdir> <input.fiets|directory>...\n"
+                  "       %s --serve <directory> [port]\n"
+                  "       %s --check [--update] <papers directory> <html directory>\n"
+                  "       %s --save-ast <input.fiets> <output.ast>\n"
+                  "       %s --bench [--synthetic-size <MB>] [--code|--tables|--links|--markup <fraction>]\n"
+                  "              [--write-synthetic <file>] [<input.fiets|directory>...]\n"
+                  "       %s --bench-check\n"
+                  "Any of these can be preceded by --stats, to print time, calls, bytes and allocations per phase,\n"
+                  "and --stats-trace <file.json>, to write every call as a Chrome trace (builds with FIETS_STATS only).\n",
+          argv[0], argv[0], argv[0], argv[0], argv[0], argv[0], argv[0]);
+  return 1;
+}
+
+int main(int argc, char** argv) {
+  bool summary = false;
+  const char* trace = nullptr;
+  int first = 1;
+  for (; first < argc; first++) {
+    if (argv[first] == std::string_view("--stats")) summary = true;
+    else if (argv[first] == std::string_view("--stats-trace") && first + 1 < argc) trace = argv[++first];
+    else break;
+  }
+  if (first == 1) return run(argc, argv);
+  argv[first - 1] = argv[0];
+#if FIETS_STATS
+  stats_start(trace != nullptr);
+  int result = run(argc - first + 1, argv + first - 1);
+  if (summary) stats_print(stderr);
+  if (trace && !stats_write_trace(trace)) {
+    fprintf(stderr, "Cannot write %s\n", trace);
+    result = 1;
+  }
+  return result;
+#else
+  (void)summary, (void)trace;
+  fprintf(stderr, "%s: --stats and --stats-trace need a build with -DFIETS_STATS=1 (toolsets/linux-stats.toolset)\n", argv[0]);
+  return 1;
+#endif
+}
 
@@ -0,0 +1,50 @@
+#include "mapped_file.h"
+#include "stats.h"
+#include <fstream>
+#if __has_include(<sys/mman.h>)
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+std::unique_ptr<MappedFile> MappedFile::open(const std::filesystem::path& path) {
+  STATS_SCOPE(scope, Phase::Read);
+  std::unique_ptr<MappedFile> file(new MappedFile);
+#if __has_include(<sys/mman.h>)
+  int fd = ::open(path.c_str(), O_RDONLY);
+  if (fd < 0) return nullptr;
+  struct stat st;
+  if (fstat(fd, &st) == 0 && S_ISREG(st.st_mode) && st.st_size > 0) {
+    void* p = mmap(nullptr, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    if (p != MAP_FAILED) {
+      madvise(p, st.st_size, MADV_SEQUENTIAL);
+      file->mapping = p;
+      file->contents = std::string_view(static_cast<const char*>(p), st.st_size);
+      STATS_BYTES(scope, st.st_size);
+    }
+  }
+  close(fd);
+  if (file->mapping) return file;
+#endif
+  file = copy(path);
+  if (file) STATS_BYTES(scope, file->data().size());
+  return file;
+}
+
+std::unique_ptr<MappedFile> MappedFile::copy(const std::filesystem::path& path) {
+  std::unique_ptr<MappedFile> file(new MappedFile);
+  std::error_code ec;
+  size_t size = std::filesystem::file_size(path, ec);
+  if (ec) return nullptr;
+  file->buffer.resize(size);
+  if (!std::ifstream(path, std::ios::binary).read(file->buffer.data(), size)) return nullptr;
+  file->contents = file->buffer;
+  return file;
+}
+
+MappedFile::~MappedFile() {
+#if __has_include(<sys/mman.h>)
+  if (mapping) munmap(mapping, contents.size());
+#endif
+}
@@ -0,0 +1,26 @@
+#pragma once
+
+#include <filesystem>
+#include <memory>
+#include <string>
+#include <string_view>
+
+// Read-only contents of a file. Memory-mapped where the platform supports it; otherwise (or if
+// mapping fails) the file is read into memory.
+struct MappedFile {
+  // Returns nullptr if the file cannot be read.
+  static std::unique_ptr<MappedFile> open(const std::filesystem::path& path);
+  // Always reads into memory; for files that may be rewritten while the contents are in use,
+  // where a mapping would change underneath the reader (or fault when the file is truncated).
+  static std::unique_ptr<MappedFile> copy(const std::filesystem::path& path);
+  MappedFile(const MappedFile&) = delete;
+  MappedFile& operator=(const MappedFile&) = delete;
+  ~MappedFile();
+  std::string_view data() const { return contents; }
+  bool mapped() const { return mapping != nullptr; }
+private:
+  MappedFile() = default;
+  void* mapping = nullptr;
+  std::string buffer;
+  std::string_view contents;
+};
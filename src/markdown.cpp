@@ -0,0 +1,205 @@
+#include "markdown.h"
+
+// Backslash-escapes the characters that would otherwise start Markdown (or HTML) markup.
+void MarkdownBackend::escaped(std::string_view text) {
+  size_t start = 0;
+  for (size_t n = 0; n < text.size(); n++) {
+    if (std::string_view("\\`*_[]<>|~#").find(text[n]) == std::string_view::npos) continue;
+    *out << text.substr(start, n - start) << '\\' << text[n];
+    start = n + 1;
+  }
+  *out << text.substr(start);
+}
+
+// Ends a link whose text has been written: the URL goes between <> so that spaces and parentheses
+// in it are kept, with the characters that would end it escaped.
+void MarkdownBackend::link(std::string_view url) {
+  *out << "](<";
+  size_t start = 0;
+  for (size_t n = 0; n < url.size(); n++) {
+    if (url[n] != '<' && url[n] != '>' && url[n] != '\\') continue;
+    *out << url.substr(start, n - start) << '\\' << url[n];
+    start = n + 1;
+  }
+  *out << url.substr(start) << ">)";
+}
+
+// A run of backticks longer than any inside text, so that text can sit between two of them.
+static std::string fence_for(std::string_view text, size_t minimum) {
+  std::string fence(minimum, '`');
+  while (text.find(fence) != std::string_view::npos) fence += '`';
+  return fence;
+}
+
+void MarkdownBackend::beginDocument(const Document& doc, const std::vector<OutlineEntry>& outline) {
+  this->doc = &doc;
+  this->outline = &outline;
+  *out << "# ";
+  escaped(doc.title);
+  *out << "\n\n";
+  if (!doc.subtitle.empty()) {
+    *out << '_';
+    escaped(doc.subtitle);
+    *out << "_\n\n";
+  }
+}
+
+// The title is the only level-1 heading, so chapters start at level 2.
+bool MarkdownBackend::beginChapter(const OutlineEntry& entry) {
+  *out << std::string(std::min<size_t>(entry.chapter->level + 1, 6), '#') << " <a id=\"" << entry.anchor << "\"></a>" << entry.number << ' ';
+  escaped(entry.chapter->title);
+  *out << "\n\n";
+  return true;
+}
+
+void MarkdownBackend::endParagraph() {
+  *out << "\n\n";
+}
+
+void MarkdownBackend::beginList(bool ordered) {
+  this->ordered = ordered;
+  item = 0;
+}
+
+void MarkdownBackend::endList(bool) {
+  *out << '\n';
+}
+
+void MarkdownBackend::beginListItem() {
+  if (ordered) *out << ++item << ". ";
+  else *out << "- ";
+}
+
+void MarkdownBackend::endListItem() {
+  *out << '\n';
+}
+
+void MarkdownBackend::endQuote() {
+  *out << '\n';
+}
+
+void MarkdownBackend::beginQuoteLine() {
+  *out << "> ";
+}
+
+void MarkdownBackend::endQuoteLine() {
+  *out << "\n";
+}
+
+// Markdown tables need a header row. Rows are collected so that a table without one can get an
+// empty header with the right number of columns.
+void MarkdownBackend::beginTable() {
+  tableHead = false;
+}
+
+void MarkdownBackend::endTable() {
+  *out << '\n';
+}
+
+void MarkdownBackend::beginRow(bool) {
+  row.clear();
+  cells = 0;
+  out = &rowOut;
+  *out << '|';
+}
+
+void MarkdownBackend::endRow(bool header) {
+  out = &final;
+  if (!tableHead && !header) {
+    *out << '|';
+    for (size_t n = 0; n < cells; n++) *out << "   |";
+    *out << '\n';
+  }
+  if (!tableHead) {
+    if (header) *out << row << '\n';
+    *out << '|';
+    for (size_t n = 0; n < cells; n++) *out << " --- |";
+    *out << '\n';
+    tableHead = true;
+    if (header) return;
+  }
+  *out << row << '\n';
+}
+
+void MarkdownBackend::beginCell(bool) {
+  *out << ' ';
+  cells++;
+}
+
+void MarkdownBackend::endCell(bool) {
+  *out << " |";
+}
+
+bool MarkdownBackend::beginDefinition(std::string_view identifier) {
+  *out << '*';
+  escaped(identifier);
+  *out << "*: ";
+  return true;
+}
+
+void MarkdownBackend::endDefinition() {
+  *out << "\n\n";
+}
+
+void MarkdownBackend::code(const Code& c) {
+  std::string fence = fence_for(c.body, 3);
+  *out << fence << c.language << '\n' << c.body << '\n' << fence << "\n\n";
+}
+
+void MarkdownBackend::toc() {
+  for (auto& entry : *outline) {
+    for (size_t n = 1; n < entry.depth; n++) *out << "  ";
+    *out << "- [" << entry.number << ' ';
+    escaped(entry.chapter->title);
+    *out << "](#" << entry.anchor << ")\n";
+  }
+  *out << '\n';
+}
+
+void MarkdownBackend::references() {
+  for (auto& ref : doc->references) {
+    *out << size_t(ref.index) << ". [";
+    escaped(ref.name);
+    link(ref.url);
+    *out << '\n';
+  }
+  *out << '\n';
+}
+
+void MarkdownBackend::text(std::string_view text) {
+  escaped(text);
+}
+
+void MarkdownBackend::beginInsertion() {
+  *out << "<ins>";
+}
+
+void MarkdownBackend::endInsertion() {
+  *out << "</ins>";
+}
+
+void MarkdownBackend::beginDeletion() {
+  *out << "~~";
+}
+
+void MarkdownBackend::endDeletion() {
+  *out << "~~";
+}
+
+void MarkdownBackend::reference(const Referenced& ref) {
+  *out << '[';
+  escaped(ref.name);
+  link(ref.url);
+}
+
+void MarkdownBackend::identifier(std::string_view identifier) {
+  *out << '*';
+  escaped(identifier);
+  *out << '*';
+}
+
+void MarkdownBackend::codeSpan(std::string_view code) {
+  std::string fence = fence_for(code, 1);
+  bool pad = !code.empty() && (code.front() == '`' || code.back() == '`');
+  *out << fence << (pad ? " " : "") << code << (pad ? " " : "") << fence;
+}
@@ -0,0 +1,56 @@
+#pragma once
+
+#include "backend.h"
+#include "sink.h"
+#include <string>
+
+// Bump when the Markdown output changes, so cached outputs get rebuilt.
+constexpr std::string_view markdown_version = "fiets-markdown-2";
+
+// Writes a paper as (GitHub-flavoured) Markdown. Headings carry their anchor as an empty <a id>,
+// since GitHub makes up its own heading ids; insertions become <ins> and deletions ~~strikethrough~~.
+struct MarkdownBackend : Backend {
+  MarkdownBackend(Sink& out) : final(out), out(&out), rowOut(row) {}
+  size_t written() const override { return final.written() + (out == &rowOut ? rowOut.written() : 0); }
+  void beginDocument(const Document& doc, const std::vector<OutlineEntry>& outline) override;
+  bool beginChapter(const OutlineEntry& entry) override;
+  void endParagraph() override;
+  void beginList(bool ordered) override;
+  void endList(bool ordered) override;
+  void beginListItem() override;
+  void endListItem() override;
+  void endQuote() override;
+  void beginQuoteLine() override;
+  void endQuoteLine() override;
+  void beginTable() override;
+  void endTable() override;
+  void beginRow(bool header) override;
+  void endRow(bool header) override;
+  void beginCell(bool header) override;
+  void endCell(bool header) override;
+  bool beginDefinition(std::string_view identifier) override;
+  void endDefinition() override;
+  void code(const Code& code) override;
+  void toc() override;
+  void references() override;
+  void text(std::string_view text) override;
+  void beginInsertion() override;
+  void endInsertion() override;
+  void beginDeletion() override;
+  void endDeletion() override;
+  void reference(const Referenced& ref) override;
+  void identifier(std::string_view identifier) override;
+  void codeSpan(std::string_view code) override;
+private:
+  void escaped(std::string_view text);
+  void link(std::string_view url);
+  Sink& final;
+  // final, or rowOut while a table row is collected.
+  Sink* out;
+  const Document* doc = nullptr;
+  const std::vector<OutlineEntry>* outline = nullptr;
+  bool ordered = false, tableHead = false;
+  size_t item = 0, cells = 0;
+  std::string row;
+  StringSink rowOut;
+};
@@ -0,0 +1,47 @@
+#include "outline.h"
+#include "stats.h"
+#include <unordered_set>
+
+std::string as_id(std::string_view title) {
+  std::string id(title);
+  for (char& c : id) {
+    if ((c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z') || (c >= '0' && c <= '9') || c == '_' || c == '-') continue;
+    c = c == '+' ? 'p' : '-';
+  }
+  return id;
+}
+
+static size_t count(const Chapter& ch) {
+  size_t n = ch.subchapters.size();
+  for (auto& sub : ch.subchapters) n += count(sub);
+  return n;
+}
+
+// used holds views of the anchors in outline, which is reserved up front so that they stay put.
+static void resolve(const Chapter& ch, std::string& number, size_t depth, std::vector<OutlineEntry>& outline, std::unordered_set<std::string_view>& used) {
+  size_t prefix = number.size();
+  for (size_t n = 0; n < ch.subchapters.size(); n++) {
+    const Chapter& sub = ch.subchapters[n];
+    number.resize(prefix);
+    if (depth > 0) number += '.';
+    number += std::to_string(n + 1);
+    OutlineEntry& entry = outline.emplace_back(OutlineEntry{&sub, number, as_id(sub.title), depth + 1});
+    if (used.count(entry.anchor)) {
+      std::string base = entry.anchor;
+      for (size_t k = 2; used.count(entry.anchor); k++) entry.anchor = base + "-" + std::to_string(k);
+    }
+    used.insert(entry.anchor);
+    resolve(sub, number, depth + 1, outline, used);
+  }
+}
+
+std::vector<OutlineEntry> resolve(const Document& doc) {
+  STATS_SCOPE(scope, Phase::Outline);
+  std::vector<OutlineEntry> outline;
+  outline.reserve(count(doc));
+  std::unordered_set<std::string_view> used;
+  used.reserve(outline.capacity());
+  std::string number;
+  resolve(doc, number, 0, outline, used);
+  return outline;
+}
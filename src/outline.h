@@ -0,0 +1,22 @@
+#pragma once
+
+#include "parser.h"
+#include <string>
+#include <string_view>
+#include <vector>
+
+// Where a chapter ends up in the rendered document: its section number ("2.3"), the id its
+// heading can be linked to, and its depth in the table of contents (1 for top-level chapters).
+struct OutlineEntry {
+  const Chapter* chapter;
+  std::string number;
+  std::string anchor;
+  size_t depth;
+};
+
+// Resolves every chapter below doc once, in document order. Anchors are made from the titles; one
+// that an earlier chapter already uses gets "-2", "-3", ... appended so that every id is unique.
+std::vector<OutlineEntry> resolve(const Document& doc);
+
+// Letters, digits, '_' and '-' are kept, '+' becomes 'p' and any other byte '-'.
+std::string as_id(std::string_view title);
@@ -1,167 +1,288 @@
 #include "parser.h"
+#include "hash.h"
+#include "stats.h"
 #include <string_view>
+#include <algorithm>
+#include <array>
+#include <cctype>
+#include <thread>
+#include <cstring>
 
-uint32_t Document::addReference(std::string url, std::string name) {
-  for (size_t n = 0; n < references.size(); n++) {
-    if (references[n].url == url) return references[n].index;
-  }
-  references.push_back(Referenced{(uint32_t)references.size() + 1, url, name});
-  return references.back().index;
+uint32_t Document::addReference(std::string_view url, std::string_view name) {
+  STATS_SCOPE(scope, Phase::AddReference, url.size());
+  auto [it, added] = referenceIndex.try_emplace(url, (uint32_t)references.size() + 1);
+  if (added) references.push_back(Referenced{it->second, url, name});
+  return it->second;
 }
 
-std::vector<std::string_view> split(std::string_view data, std::string chars) {
-  std::vector<std::string_view> lines;
-  size_t start = 0;
-  size_t end = data.find_first_of(chars);
-  while (start != std::string::npos) {
-    lines.push_back(std::string_view(data.data() + start, (end == std::string::npos ? data.size() : end) - start));
-    if (end == std::string::npos) break;
-    start = end + 1;
-    end = data.find_first_of(chars, start);
-  }
-  return lines;
+std::string_view Document::store(std::string_view text) {
+  char* copy = static_cast<char*>(arena->allocate(text.size(), 1));
+  std::copy(text.begin(), text.end(), copy);
+  return std::string_view(copy, text.size());
 }
 
-Text parseText(std::string_view line, Document& doc) {
-  Text text;
-  std::string accum;
-  size_t offset = 0;
-  while (offset != line.size()) {
-    size_t end = line.find_first_of("`+-\\['", offset);
-    if (end == std::string::npos) {
-      accum += line.substr(offset);
-      text.seq.push_back(accum);
-      offset = line.size();
-      break;
+// A run of prose. It stays a view of the source until an escape makes its bytes differ from it.
+struct TextRun {
+  std::string_view view;
+  std::string owned;
+  bool isOwned = false;
+  bool empty() const { return isOwned ? owned.empty() : view.empty(); }
+  void append(std::string_view piece) {
+    if (isOwned) {
+      owned += piece;
+    } else if (view.empty()) {
+      view = piece;
+    } else if (view.data() + view.size() == piece.data()) {
+      view = std::string_view(view.data(), view.size() + piece.size());
     } else {
-      accum += line.substr(offset, end - offset);
-      offset = end;
-      switch(line[offset]) {
-      case '\\':
-        accum += line[offset+1];
-        offset += 2;
+      owned = std::string(view) + std::string(piece);
+      isOwned = true;
+    }
+  }
+  void flush(Text& text, Document& doc) {
+    text.seq.push_back(isOwned ? doc.store(owned) : view);
+    view = {};
+    owned.clear();
+    isOwned = false;
+  }
+};
+
+// Yields the pieces of text between separators one at a time, so no index of them is built.
+// A text ending in a separator has an empty last piece, and an empty text one empty piece.
+struct Splitter {
+  std::string_view rest;
+  char separator;
+  bool done = false;
+  bool next(std::string_view& piece) {
+    if (done) return false;
+    const char* found = static_cast<const char*>(memchr(rest.data(), separator, rest.size()));
+    if (!found) {
+      piece = rest;
+      done = true;
+    } else {
+      piece = rest.substr(0, found - rest.data());
+      rest.remove_prefix(piece.size() + 1);
+    }
+    return true;
+  }
+};
+
+enum class Markup : uint8_t {
+  Plain,
+  Escape,
+  Plus,
+  Minus,
+  Quote,
+  Bracket,
+  Backtick,
+};
+
+constexpr std::array<Markup, 256> markup_types = [] {
+  std::array<Markup, 256> types{};
+  types['\\'] = Markup::Escape;
+  types['+'] = Markup::Plus;
+  types['-'] = Markup::Minus;
+  types['\''] = Markup::Quote;
+  types['['] = Markup::Bracket;
+  types['`'] = Markup::Backtick;
+  return types;
+}();
+
+// Lexes the inline markup of a line in one forward pass. Insertions and deletions nest through
+// text(), which runs until its own closing delimiter, the closing delimiter of an enclosing span
+// or the end of the line. Code spans, identifiers and links scan ahead for their closing character
+// within the same bounds and take the rest of the span when it is missing.
+struct Lexer {
+  std::string_view line;
+  Document& doc;
+  size_t offset = 0;
+  bool inInsertion = false, inDeletion = false;
+  // A failed search for ']' that started at bracketMissFrom ran up to bracketMissTo without finding one.
+  size_t bracketMissFrom = std::string_view::npos, bracketMissTo = 0;
+
+  // Whether an open insertion or deletion ends at pos.
+  bool closes(size_t pos) const {
+    return (inInsertion && line.substr(pos, 3) == "+++") || (inDeletion && line.substr(pos, 3) == "---");
+  }
+
+  // Returns the position of c at or after from, or where the current span ends if there is none.
+  size_t scan(size_t from, char c, bool& found) const {
+    size_t pos = from;
+    while (pos < line.size() && line[pos] != c && !((line[pos] == '+' || line[pos] == '-') && closes(pos))) pos++;
+    found = pos < line.size() && line[pos] == c;
+    return pos;
+  }
+
+  void span(Text& text, TextRun& accum, bool& open) {
+    if (!accum.empty()) accum.flush(text, doc);
+    std::string_view delimiter = line.substr(offset, 3);
+    offset += 3;
+    bool wasOpen = open;
+    open = true;
+    Text inner(doc.arena.get());
+    this->text(inner);
+    open = wasOpen;
+    if (line.substr(offset, 3) == delimiter) offset += 3;
+    if (delimiter == "+++") text.seq.push_back(Insertion{std::move(inner)});
+    else text.seq.push_back(Deletion{std::move(inner)});
+  }
+
+  void text(Text& text) {
+    TextRun accum;
+    size_t start = offset;
+    while (offset < line.size()) {
+      size_t plain = offset;
+      while (plain < line.size() && markup_types[(unsigned char)line[plain]] == Markup::Plain) plain++;
+      accum.append(line.substr(offset, plain - offset));
+      offset = plain;
+      if (offset == line.size() || closes(offset)) break;
+      switch(markup_types[(unsigned char)line[offset]]) {
+      case Markup::Plain:
         break;
-      case '+': 
-        if (line[offset+1] == '+' && line[offset+2] == '+') {
-          if (!accum.empty()) text.seq.push_back(accum);
-          accum = "";
-          size_t end = line.find("+++", offset + 3);
-          text.seq.push_back(Insertion{parseText(line.substr(offset + 3, end == std::string::npos ? end : end - offset - 3), doc)});
-          offset = end == std::string::npos ? line.size() : end + 3;
-        } 
-        else 
-        {
-          accum += '+';
+      case Markup::Escape:
+        if (offset + 1 < line.size() && !closes(offset + 1)) {
+          accum.append(line.substr(offset + 1, 1));
+          offset += 2;
+        } else {
           offset++;
         }
         break;
-      case '-':
-        if (line[offset+1] == '-' && line[offset+2] == '-') {
-          if (!accum.empty()) text.seq.push_back(accum);
-          accum = "";
-          size_t end = line.find("---", offset + 3);
-          text.seq.push_back(Deletion{parseText(line.substr(offset + 3, end - offset - 3), doc)});
-          offset = end + 3;
-        } 
-        else 
-        {
-          accum += '-';
+      case Markup::Plus:
+      case Markup::Minus:
+        if (line.substr(offset, 3) == "+++") {
+          span(text, accum, inInsertion);
+        } else if (line.substr(offset, 3) == "---") {
+          span(text, accum, inDeletion);
+        } else {
+          accum.append(line.substr(offset, 1));
           offset++;
         }
         break;
-      case '\'':
+      case Markup::Quote:
       {
-        if (!std::isspace(line[offset-1]) && !std::isspace(line[offset+1])) {
-          // Apostrophe inside a word, ignore
-          accum += '\'';
+        // An apostrophe inside a word is just text; the edges of a span count as whitespace.
+        bool spaceBefore = offset == start || std::isspace((unsigned char)line[offset - 1]);
+        bool spaceAfter = offset + 1 == line.size() || closes(offset + 1) || std::isspace((unsigned char)line[offset + 1]);
+        if (!spaceBefore && !spaceAfter) {
+          accum.append(line.substr(offset, 1));
           offset++;
-        } else {
-          if (!accum.empty()) text.seq.push_back(accum);
-          accum = "";
-          size_t end = line.find("'", offset + 1);
-          text.seq.push_back(Identifier{line.substr(offset + 1, end - offset - 1)});
-          offset = end + 1;
+          break;
         }
+        if (!accum.empty()) accum.flush(text, doc);
+        bool found;
+        size_t end = scan(offset + 1, '\'', found);
+        text.seq.push_back(Identifier{line.substr(offset + 1, end - offset - 1)});
+        offset = found ? end + 1 : end;
       }
         break;
-      case '[':
+      case Markup::Bracket:
       {
-        if (!accum.empty()) text.seq.push_back(accum);
-        accum = "";
-        size_t end = line.find("]", offset + 1);
-        if (line[end+1] == '(') {
-          size_t end2 = line.find(")", end + 2);
-          uint32_t index = doc.addReference(std::string(line.substr(end + 2, end2 - end - 2)), std::string(line.substr(offset + 1, end - offset - 1)));
-          text.seq.push_back(Reference{index});
-          offset = end2 + 1;
+        bool found = false;
+        size_t end = offset >= bracketMissFrom && offset < bracketMissTo ? bracketMissTo : scan(offset + 1, ']', found);
+        if (!found) {
+          // Not a link, just a bracket.
+          bracketMissFrom = offset;
+          bracketMissTo = end;
+          accum.append(line.substr(offset, 1));
+          offset++;
+          break;
+        }
+        if (!accum.empty()) accum.flush(text, doc);
+        std::string_view name = line.substr(offset + 1, end - offset - 1);
+        if (end + 1 < line.size() && line[end + 1] == '(') {
+          size_t end2 = scan(end + 2, ')', found);
+          text.seq.push_back(Reference{doc.addReference(line.substr(end + 2, end2 - end - 2), name)});
+          offset = found ? end2 + 1 : end2;
         } else {
-          uint32_t index = doc.addReference(std::string(line.substr(offset + 1, end - offset - 1)), std::string(line.substr(offset + 1, end - offset - 1)));
-          text.seq.push_back(Reference{index});
+          text.seq.push_back(Reference{doc.addReference(name, name)});
           offset = end + 1;
         }
       }
         break;
-      case '`':
+      case Markup::Backtick:
       {
-        if (!accum.empty()) text.seq.push_back(accum);
-        accum = "";
-        size_t end = line.find("`", offset + 1);
+        if (!accum.empty()) accum.flush(text, doc);
+        bool found;
+        size_t end = scan(offset + 1, '`', found);
         text.seq.push_back(CodeSpan{line.substr(offset + 1, end - offset - 1)});
-        offset = end + 1;
+        offset = found ? end + 1 : end;
       }
         break;
       }
     }
+    if (!accum.empty()) accum.flush(text, doc);
   }
+};
+
+Text parseText(std::string_view line, Document& doc) {
+  STATS_SCOPE(scope, Phase::ParseText, line.size());
+  Text text(doc.arena.get());
+  Lexer{line, doc}.text(text);
   return text;
 }
 
-Document parse(std::string_view file) {
-  size_t lineNumber = 0;
-  Document doc;
+// Builds doc from its lines, fed one at a time and numbered from firstLine. Lines 1 and 2 are the
+// title and subtitle. Lines fed in one call to parseLines() are consecutive slices of one buffer,
+// so a code block's body stays a view of it; one whose lines come from different buffers is
+// copied into the arena.
+struct LineParser {
+  Document& doc;
+  size_t lineNumber;
+  Diagnostics* diagnostics;
+  size_t codeLine = 0;
   Chapter* currentChapter = &doc;
-  std::string accumulated = "";
-  std::string codeLanguage = "";
+  std::string_view codeBody;
+  std::string codeCopy;
+  bool codeCopied = false;
+  std::string_view codeLanguage;
   enum {
     Toplevel,
     Codeblock,
   } state = Toplevel;
-  for (auto& line : split(file, "\n")) {
+
+  LineParser(Document& doc, size_t firstLine, Diagnostics* diagnostics)
+  : doc(doc)
+  , lineNumber(firstLine - 1)
+  , diagnostics(diagnostics)
+  {}
+
+  void line(std::string_view line) {
     lineNumber++;
-    printf("line %zu\n", lineNumber);
     if (lineNumber == 1) {
       doc.title = line;
-      continue;
+      return;
     } else if (lineNumber == 2 && !line.empty()) {
       doc.subtitle = line;
-      continue;
+      return;
     }
     switch(state) {
     case Toplevel:
       if (line.empty()) { }
       else if (line.starts_with("#")) {
-        size_t hashCount = line.find_first_not_of("#");
+        size_t hashCount = std::min(line.find_first_not_of("#"), line.size());
         currentChapter = &doc;
         for (size_t n = 0; n < hashCount - 1; n++) {
           if (currentChapter->subchapters.empty()) {
-            fprintf(stderr, "Chapter omitted in sequence on line %zu", lineNumber);
-            currentChapter->subchapters.emplace_back(n+1, "");
+            if (diagnostics) diagnostics->report(Severity::Warning, lineNumber, 1, "chapter omitted in sequence");
+            currentChapter->subchapters.emplace_back(doc.arena.get(), n+1, "");
           }
           currentChapter = &currentChapter->subchapters.back();
         }
-        currentChapter->subchapters.emplace_back(hashCount, line.substr(hashCount + 1));
+        currentChapter->subchapters.emplace_back(doc.arena.get(), hashCount, line.substr(std::min(hashCount + 1, line.size())));
         currentChapter = &currentChapter->subchapters.back();
       } else if (line.starts_with("```")) {
         state = Codeblock;
+        codeLine = lineNumber;
         codeLanguage = line.substr(3);
-        accumulated = "";
+        codeBody = {};
+        codeCopied = false;
       } else if (line.starts_with("> ")) {
         Text text = parseText(line.substr(2), doc);
         if (currentChapter->entries.empty() ||
             not std::holds_alternative<Quote>(currentChapter->entries.back())) {
-          currentChapter->entries.push_back(Quote{});
+          currentChapter->entries.push_back(Quote(doc.arena.get()));
         }
-        std::get<Quote>(currentChapter->entries.back()).texts.push_back(text);
+        std::get<Quote>(currentChapter->entries.back()).texts.push_back(std::move(text));
       } else if (line.starts_with("[[references]]")) {
         currentChapter->entries.push_back(References());
       } else if (line.starts_with("[[TOC]]")) {
@@ -169,7 +290,7 @@ Document parse(std::string_view file) {
       } else if (line.starts_with("- ")) {
         if (currentChapter->entries.empty() ||
           !std::holds_alternative<List>(currentChapter->entries.back()))
-          currentChapter->entries.push_back(List{});
+          currentChapter->entries.push_back(List(doc.arena.get()));
 
         std::get<List>(currentChapter->entries.back()).entries.push_back(parseText(line.substr(2), doc));
       } else if (line.starts_with("'") && line.find("':") != std::string::npos) {
@@ -178,12 +299,13 @@ Document parse(std::string_view file) {
       } else if (line.starts_with("|")) {
         if (currentChapter->entries.empty() ||
           !std::holds_alternative<Table>(currentChapter->entries.back()))
-          currentChapter->entries.push_back(Table{});
+          currentChapter->entries.push_back(Table(doc.arena.get()));
 
-        std::get<Table>(currentChapter->entries.back()).entries.push_back({});
+        std::get<Table>(currentChapter->entries.back()).entries.emplace_back(doc.arena.get());
         auto& lineEntries = std::get<Table>(currentChapter->entries.back()).entries.back();
-        for (auto entry : split(line.substr(1, line.size() - 2), "|")) {
-          lineEntries.push_back(parseText(entry, doc));
+        Splitter cells{line.substr(1, line.size() - 2), '|'};
+        for (std::string_view cell; cells.next(cell); ) {
+          lineEntries.push_back(parseText(cell, doc));
         }
       } else if (line.size() >= 10 && line.find_first_not_of("-") == std::string::npos) {
 //        currentChapter->entries.push_back(PageBreak{});
@@ -196,16 +318,180 @@ Document parse(std::string_view file) {
     case Codeblock:
       if (line == "```") {
         state = Toplevel;
-        currentChapter->entries.push_back(Code{codeLanguage, accumulated});
+        currentChapter->entries.push_back(Code{codeLanguage, codeCopied ? doc.store(codeCopy) : codeBody});
+      } else if (codeBody.empty() && !codeCopied) {
+        // Leading empty lines are dropped; after that the body is one contiguous slice of the file.
+        codeBody = line;
+      } else if (!codeCopied && codeBody.data() + codeBody.size() + 1 == line.data()) {
+        codeBody = std::string_view(codeBody.data(), line.data() + line.size() - codeBody.data());
       } else {
-        if (not accumulated.empty())
-          accumulated += "\n";
-        accumulated += line;
+        if (!codeCopied) codeCopy = codeBody;
+        codeCopied = true;
+        codeCopy += '\n';
+        codeCopy += line;
       }
       break;
     }
+    currentChapter->contentHash = hash(line, hash("\n", currentChapter->contentHash));
+  }
+
+  void finish() {
+    if (state == Codeblock && diagnostics) {
+      diagnostics->report(Severity::Warning, codeLine, 1, "code block is never closed and is left out");
+    }
+  }
+};
+
+static void parseLines(Document& doc, std::string_view file, size_t firstLine, Diagnostics* diagnostics) {
+  STATS_SCOPE(scope, Phase::Parse, file.size());
+  LineParser parser(doc, firstLine, diagnostics);
+  Splitter lines{file, '\n'};
+  for (std::string_view line; lines.next(line); ) parser.line(line);
+  parser.finish();
+}
+
+Document parse(std::string_view file, Diagnostics* diagnostics) {
+  Document doc;
+  parseLines(doc, file, 1, diagnostics);
+  return doc;
+}
+
+struct Segment {
+  std::string_view text;
+  size_t firstLine;
+};
+
+// Cuts file before level-1 headings outside code blocks, into at most count segments of similar size.
+static std::vector<Segment> segments(std::string_view file, size_t count) {
+  std::vector<Segment> found{{file, 1}};
+  size_t target = file.size() / count;
+  bool code = false;
+  size_t lineNumber = 0;
+  Splitter lines{file, '\n'};
+  for (std::string_view line; found.size() < count && lines.next(line); ) {
+    lineNumber++;
+    if (code) {
+      code = line != "```";
+    } else if (line.starts_with("```") && lineNumber > 2) {
+      code = true;
+    } else if (lineNumber > 2 && line.starts_with("#") && !line.starts_with("##") &&
+               size_t(line.data() - found.back().text.data()) >= target) {
+      Segment& last = found.back();
+      last.text = std::string_view(last.text.data(), line.data() - 1 - last.text.data());
+      found.push_back(Segment{file.substr(line.data() - file.data()), lineNumber});
+    }
+  }
+  return found;
+}
+
+// Renumbers the references in text from a segment's numbering to the merged document's.
+static void remap(Text& text, const std::vector<uint32_t>& index) {
+  for (auto& part : text.seq) {
+    if (auto* r = std::get_if<Reference>(&part)) r->index = index[r->index - 1];
+    else if (auto* i = std::get_if<Insertion>(&part)) remap(i->text, index);
+    else if (auto* d = std::get_if<Deletion>(&part)) remap(d->text, index);
+  }
+}
+
+static void remap(Chapter& ch, const std::vector<uint32_t>& index) {
+  for (auto& entry : ch.entries) {
+    if (auto* text = std::get_if<Text>(&entry)) remap(*text, index);
+    else if (auto* list = std::get_if<List>(&entry)) for (auto& t : list->entries) remap(t, index);
+    else if (auto* list = std::get_if<OrderedList>(&entry)) for (auto& t : list->entries) remap(t, index);
+    else if (auto* quote = std::get_if<Quote>(&entry)) for (auto& t : quote->texts) remap(t, index);
+    else if (auto* def = std::get_if<IdentifierDefinition>(&entry)) remap(def->definition, index);
+    else if (auto* table = std::get_if<Table>(&entry)) {
+      for (auto& row : table->entries) for (auto& t : row) remap(t, index);
+    }
+  }
+  for (auto& sub : ch.subchapters) remap(sub, index);
+}
+
+Document parseParallel(std::string_view file, size_t threads, Diagnostics* diagnostics) {
+  // Below this a segment is not worth a thread of its own.
+  constexpr size_t minSegment = 32768;
+  std::vector<Segment> parts = segments(file, std::max<size_t>(1, std::min(threads, file.size() / minSegment)));
+  if (parts.size() == 1) return parse(file, diagnostics);
+
+  // The first segment, with the title and anything before the first chapter, is parsed into the
+  // result on this thread; the others into documents of their own that are merged in after.
+  std::vector<Document> docs(parts.size() - 1);
+  std::vector<Diagnostics> found(parts.size());
+  std::vector<std::thread> workers;
+  for (size_t n = 1; n < parts.size(); n++) {
+    workers.emplace_back([&, n] { parseLines(docs[n - 1], parts[n].text, parts[n].firstLine, &found[n]); });
+  }
+  Document doc;
+  parseLines(doc, parts[0].text, 1, &found[0]);
+  for (auto& t : workers) t.join();
+
+  // Adding each segment's references in order gives the first-seen numbering a single pass would.
+  std::vector<uint32_t> index;
+  for (auto& part : docs) {
+    index.clear();
+    for (auto& r : part.references) index.push_back(doc.addReference(r.url, r.name));
+    for (auto& ch : part.subchapters) {
+      remap(ch, index);
+      doc.subchapters.push_back(std::move(ch));
+    }
+    doc.arena->adopt(std::move(part.arena));
+  }
+  if (diagnostics) {
+    for (auto& d : found) diagnostics->entries.insert(diagnostics->entries.end(), d.entries.begin(), d.entries.end());
+  }
+  return doc;
+}
+
+// Reads in chunks allocated from the document's arena, since the tree points into them. The
+// partial line at the end of a chunk is carried over to the start of the next one, so every line
+// is contiguous; a chunk grows when one line does not fit in it.
+Document parse(FILE* in, Diagnostics* diagnostics) {
+  constexpr size_t chunkSize = 256 << 10;
+  STATS_SCOPE(scope, Phase::Parse);
+  Document doc;
+  LineParser parser(doc, 1, diagnostics);
+  std::string_view carry;
+  for (;;) {
+    size_t size = std::max(chunkSize, carry.size() * 2);
+    char* chunk = static_cast<char*>(doc.arena->allocate(size, 1));
+    if (!carry.empty()) memcpy(chunk, carry.data(), carry.size());
+    size_t read;
+    {
+      STATS_SCOPE(readScope, Phase::Read);
+      read = fread(chunk + carry.size(), 1, size - carry.size(), in);
+      STATS_BYTES(readScope, read);
+    }
+    STATS_BYTES(scope, read);
+    std::string_view data(chunk, carry.size() + read);
+    if (read == 0) {
+      parser.line(data);
+      break;
+    }
+    size_t last = data.rfind('\n');
+    if (last == std::string_view::npos) {
+      carry = data;
+      continue;
+    }
+    Splitter lines{data.substr(0, last), '\n'};
+    for (std::string_view line; lines.next(line); ) parser.line(line);
+    carry = data.substr(last + 1);
+  }
+  parser.finish();
+  // fread() returns 0 on a read error too; what was read is kept, but the document is incomplete.
+  if (ferror(in) && diagnostics) {
+    diagnostics->report(Severity::Error, parser.lineNumber + 1, 1, "read error; the rest of the input is missing");
   }
   return doc;
 }
 
+Document parse(std::unique_ptr<MappedFile> source, Diagnostics* diagnostics) {
+  Document doc = parse(source->data(), diagnostics);
+  doc.source = std::move(source);
+  return doc;
+}
 
+Document parseParallel(std::unique_ptr<MappedFile> source, size_t threads, Diagnostics* diagnostics) {
+  Document doc = parseParallel(source->data(), threads, diagnostics);
+  doc.source = std::move(source);
+  return doc;
+}
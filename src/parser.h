@@ -1,8 +1,14 @@
 #pragma once
 
+#include "arena.h"
+#include "mapped_file.h"
+#include "diagnostics.h"
+#include <cstdio>
+#include <memory>
+#include <unordered_map>
 #include <variant>
-#include <vector>
 #include <string>
+#include <string_view>
 
 struct Insertion;
 struct Deletion;
@@ -12,16 +18,17 @@ struct Identifier;
 struct CodeSpan { std::string_view text; };
 struct Code {
   std::string_view language = "cpp";
-  std::string body;
+  std::string_view body;
 };
 struct Text {
-  std::vector<std::variant<std::string, Insertion, Deletion, Reference, Identifier, CodeSpan>> seq; 
+  ArenaVector<std::variant<std::string_view, Insertion, Deletion, Reference, Identifier, CodeSpan>> seq; 
+  explicit Text(Arena* arena = nullptr) : seq(arena) {}
 };
 
 struct Referenced {
   uint32_t index;
-  std::string url; 
-  std::string name;
+  std::string_view url; 
+  std::string_view name;
 };
 
 struct Insertion { Text text; };
@@ -30,19 +37,25 @@ struct Reference { uint32_t index; };
 struct Identifier { std::string_view text; };
 
 struct List {
-  std::vector<Text> entries; 
+  ArenaVector<Text> entries; 
+  explicit List(Arena* arena = nullptr) : entries(arena) {}
 };
 struct OrderedList {
-  std::vector<Text> entries; 
+  ArenaVector<Text> entries; 
+  explicit OrderedList(Arena* arena = nullptr) : entries(arena) {}
 };
 struct IdentifierDefinition {
   std::string_view identifier; 
   Text definition;
 };
 struct Table {
-  std::vector<std::vector<Text>> entries;
+  ArenaVector<ArenaVector<Text>> entries;
+  explicit Table(Arena* arena = nullptr) : entries(arena) {}
+};
+struct Quote {
+  ArenaVector<Text> texts;
+  explicit Quote(Arena* arena = nullptr) : texts(arena) {}
 };
-struct Quote { std::vector<Text> texts; };
 
 struct References {};
 struct TOC {};
@@ -52,19 +65,57 @@ using DocumentEntry = std::variant<Code, List, OrderedList, IdentifierDefinition
 struct Chapter {
   int level;
   std::string_view title;
-  std::vector<DocumentEntry> entries;
-  std::vector<Chapter> subchapters;
-  Chapter(int level, std::string_view title) 
+  // Hash of the source lines of this chapter's heading and own entries, excluding subchapters.
+  uint64_t contentHash = 0;
+  ArenaVector<DocumentEntry> entries;
+  ArenaVector<Chapter> subchapters;
+  Chapter(Arena* arena, int level, std::string_view title) 
   : level(level)
   , title(title)
+  , entries(arena)
+  , subchapters(arena)
   {}
 };
 
-struct Document : Chapter {
+// Owns the arena a Document's tree is allocated from, and the source file when the Document was
+// parsed from one. It is a base class listed before Chapter so that it is destroyed after the
+// tree, and the arena lives on the heap so that moving a Document does not invalidate the
+// allocators pointing at it.
+struct DocumentStorage {
+  std::unique_ptr<MappedFile> source;
+  std::unique_ptr<Arena> arena = std::make_unique<Arena>();
+};
+
+// All string_views in a Document point into the parsed source, which must outlive it, or into
+// the document's arena for text whose bytes differ from the source (escapes) and for sources
+// read from a stream.
+struct Document : DocumentStorage, Chapter {
   std::string_view subtitle;
-  Document() : Chapter{0, ""} {}
-  std::vector<Referenced> references;
-  uint32_t addReference(std::string url, std::string name);
+  Document() : Chapter{arena.get(), 0, ""}, references(arena.get()), referenceIndex(arena.get()) {}
+  Document(Document&&) = default;
+  Document(const Document&) = delete;
+  ArenaVector<Referenced> references;
+  // Returns the number of the reference to url, adding it (numbered in first-seen order) if it is new.
+  uint32_t addReference(std::string_view url, std::string_view name);
+  std::string_view store(std::string_view text);
+private:
+  std::unordered_map<std::string_view, uint32_t, std::hash<std::string_view>, std::equal_to<std::string_view>,
+                     ArenaAllocator<std::pair<const std::string_view, uint32_t>>> referenceIndex;
 };
 
-Document parse(std::string_view file);
+// Parses the inline markup of one line of prose; links are added to doc's references.
+Text parseText(std::string_view line, Document& doc);
+
+// The returned Document refers into file, so file has to stay alive as long as the Document.
+// Problems in the input are reported to diagnostics when given.
+Document parse(std::string_view file, Diagnostics* diagnostics = nullptr);
+// Parses straight from the (mapped) file, which the returned Document takes ownership of.
+Document parse(std::unique_ptr<MappedFile> source, Diagnostics* diagnostics = nullptr);
+// Parses a stream such as stdin or a pipe while it is read, line by line. The text is kept in
+// the Document's arena. A read error is reported as an error, and leaves ferror(in) set.
+Document parse(FILE* in, Diagnostics* diagnostics = nullptr);
+
+// Same result as parse(), but the file is cut at level-1 chapters outside code blocks and up to
+// threads pieces of it are parsed concurrently. Small files are parsed on the calling thread.
+Document parseParallel(std::string_view file, size_t threads, Diagnostics* diagnostics = nullptr);
+Document parseParallel(std::unique_ptr<MappedFile> source, size_t threads, Diagnostics* diagnostics = nullptr);
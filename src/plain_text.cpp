@@ -0,0 +1,130 @@
+#include "plain_text.h"
+
+void PlainTextBackend::beginDocument(const Document& doc, const std::vector<OutlineEntry>& outline) {
+  this->doc = &doc;
+  this->outline = &outline;
+  out << doc.title << '\n';
+  if (!doc.subtitle.empty()) out << doc.subtitle << '\n';
+  out << '\n';
+}
+
+bool PlainTextBackend::beginChapter(const OutlineEntry& entry) {
+  out << entry.number << ' ' << entry.chapter->title << "\n\n";
+  return true;
+}
+
+void PlainTextBackend::endParagraph() {
+  out << "\n\n";
+}
+
+void PlainTextBackend::beginList(bool ordered) {
+  this->ordered = ordered;
+  item = 0;
+}
+
+void PlainTextBackend::endList(bool) {
+  out << '\n';
+}
+
+void PlainTextBackend::beginListItem() {
+  if (ordered) out << ++item << ". ";
+  else out << "- ";
+}
+
+void PlainTextBackend::endListItem() {
+  out << '\n';
+}
+
+void PlainTextBackend::endQuote() {
+  out << '\n';
+}
+
+void PlainTextBackend::beginQuoteLine() {
+  out << "> ";
+}
+
+void PlainTextBackend::endQuoteLine() {
+  out << '\n';
+}
+
+void PlainTextBackend::endTable() {
+  out << '\n';
+}
+
+void PlainTextBackend::beginRow(bool) {
+  firstCell = true;
+}
+
+void PlainTextBackend::endRow(bool) {
+  out << '\n';
+}
+
+void PlainTextBackend::beginCell(bool) {
+  if (!firstCell) out << " | ";
+  firstCell = false;
+}
+
+bool PlainTextBackend::beginDefinition(std::string_view identifier) {
+  out << identifier << ": ";
+  return true;
+}
+
+void PlainTextBackend::endDefinition() {
+  out << "\n\n";
+}
+
+// Indented by four spaces, line by line.
+void PlainTextBackend::code(const Code& c) {
+  size_t start = 0;
+  while (start < c.body.size()) {
+    size_t end = std::min(c.body.find('\n', start), c.body.size());
+    out << "    " << c.body.substr(start, end - start) << '\n';
+    start = end + 1;
+  }
+  out << '\n';
+}
+
+void PlainTextBackend::toc() {
+  for (auto& entry : *outline) {
+    for (size_t n = 1; n < entry.depth; n++) out << "  ";
+    out << entry.number << ' ' << entry.chapter->title << '\n';
+  }
+  out << '\n';
+}
+
+void PlainTextBackend::references() {
+  for (auto& ref : doc->references) out << '[' << size_t(ref.index) << "] " << ref.name << " <" << ref.url << ">\n";
+  out << '\n';
+}
+
+void PlainTextBackend::text(std::string_view text) {
+  out << text;
+}
+
+void PlainTextBackend::beginInsertion() {
+  out << "{+";
+}
+
+void PlainTextBackend::endInsertion() {
+  out << "+}";
+}
+
+void PlainTextBackend::beginDeletion() {
+  out << "[-";
+}
+
+void PlainTextBackend::endDeletion() {
+  out << "-]";
+}
+
+void PlainTextBackend::reference(const Referenced& ref) {
+  out << ref.name << " [" << size_t(ref.index) << ']';
+}
+
+void PlainTextBackend::identifier(std::string_view identifier) {
+  out << identifier;
+}
+
+void PlainTextBackend::codeSpan(std::string_view code) {
+  out << code;
+}
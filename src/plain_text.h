@@ -0,0 +1,47 @@
+#pragma once
+
+#include "backend.h"
+#include "sink.h"
+
+// Bump when the plain-text output changes, so cached outputs get rebuilt.
+constexpr std::string_view plain_text_version = "fiets-text-1";
+
+// Writes a paper as plain text, for search indexing and mail. Insertions are marked {+ +} and
+// deletions [- -], as wdiff does; links are followed by their number in the reference list.
+struct PlainTextBackend : Backend {
+  PlainTextBackend(Sink& out) : out(out) {}
+  size_t written() const override { return out.written(); }
+  void beginDocument(const Document& doc, const std::vector<OutlineEntry>& outline) override;
+  bool beginChapter(const OutlineEntry& entry) override;
+  void endParagraph() override;
+  void beginList(bool ordered) override;
+  void endList(bool ordered) override;
+  void beginListItem() override;
+  void endListItem() override;
+  void endQuote() override;
+  void beginQuoteLine() override;
+  void endQuoteLine() override;
+  void endTable() override;
+  void beginRow(bool header) override;
+  void endRow(bool header) override;
+  void beginCell(bool header) override;
+  bool beginDefinition(std::string_view identifier) override;
+  void endDefinition() override;
+  void code(const Code& code) override;
+  void toc() override;
+  void references() override;
+  void text(std::string_view text) override;
+  void beginInsertion() override;
+  void endInsertion() override;
+  void beginDeletion() override;
+  void endDeletion() override;
+  void reference(const Referenced& ref) override;
+  void identifier(std::string_view identifier) override;
+  void codeSpan(std::string_view code) override;
+private:
+  Sink& out;
+  const Document* doc = nullptr;
+  const std::vector<OutlineEntry>* outline = nullptr;
+  bool ordered = false, firstCell = false;
+  size_t item = 0;
+};
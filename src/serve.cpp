@@ -0,0 +1,162 @@
+#include "serve.h"
+#include "parser.h"
+#include "html.h"
+#include "highlight_cache.h"
+#include "escape.h"
+#include <chrono>
+#include <cerrno>
+#include <cstdio>
+#include <map>
+#include <memory>
+#include <string>
+#ifdef __linux__
+#include <netinet/in.h>
+#include <poll.h>
+#include <sys/inotify.h>
+#include <sys/socket.h>
+#include <sys/time.h>
+#include <unistd.h>
+#endif
+
+#ifdef __linux__
+struct Paper {
+  Document doc;
+  // Replaced, not modified, when the paper is rebuilt; a response holds on to the one it sends.
+  std::shared_ptr<const std::string> html;
+  FragmentCache fragments;
+};
+
+// (Re)parses and renders one paper. Files are copied rather than mapped because editors rewrite
+// them in place while we hold on to the Document.
+static void load(std::map<std::string, Paper>& papers, HighlightCache& highlights, const std::filesystem::path& path) {
+  using clock = std::chrono::steady_clock;
+  auto start = clock::now();
+  std::string name = path.stem().string() + ".html";
+  std::unique_ptr<MappedFile> source = MappedFile::copy(path);
+  if (!source) {
+    if (papers.erase(name)) fprintf(stderr, "%s: removed\n", path.c_str());
+    return;
+  }
+  Diagnostics diagnostics;
+  diagnostics.file = path.string();
+  Document doc = parse(std::move(source), &diagnostics);
+  auto parsed = clock::now();
+  FragmentCache fragments;
+  if (auto it = papers.find(name); it != papers.end()) fragments = std::move(it->second.fragments);
+  std::string html;
+  StringSink out(html);
+  as_html(out, doc, &fragments, &highlights);
+  auto rendered = clock::now();
+  diagnostics.print(stderr);
+  fprintf(stderr, "%s: rendered in %.2f ms (parse %.2f ms, render %.2f ms, %zu of %zu chapters reused)\n", path.c_str(),
+          std::chrono::duration<double, std::milli>(rendered - start).count(),
+          std::chrono::duration<double, std::milli>(parsed - start).count(),
+          std::chrono::duration<double, std::milli>(rendered - parsed).count(),
+          fragments.reused, fragments.reused + fragments.rendered);
+  // Document is not move-assignable (its arena must outlive the old tree), so replace the entry.
+  papers.erase(name);
+  papers.emplace(name, Paper{std::move(doc), std::make_shared<const std::string>(std::move(html)), std::move(fragments)});
+}
+
+static void send_all(int fd, std::string_view data) {
+  while (!data.empty()) {
+    ssize_t sent = send(fd, data.data(), data.size(), MSG_NOSIGNAL);
+    if (sent <= 0) return;
+    data.remove_prefix(sent);
+  }
+}
+
+static void respond(int fd, const std::map<std::string, Paper>& papers) {
+  char request[4096];
+  ssize_t size = recv(fd, request, sizeof(request), 0);
+  if (size <= 0) return;
+  std::string_view line(request, size);
+  line = line.substr(0, line.find("\r\n"));
+  std::string status = "200 OK", index;
+  // The page is sent straight from the paper's rendered HTML, without copying it.
+  std::shared_ptr<const std::string> page;
+  std::string_view body;
+  if (!line.starts_with("GET /")) {
+    status = "405 Method Not Allowed";
+  } else {
+    std::string_view path = line.substr(5, line.find(' ', 5) - 5);
+    if (path.empty()) {
+      StringSink out(index);
+      out << "<!DOCTYPE html>\n<html><body><ul>";
+      for (auto& [name, paper] : papers) out << "<li><a href=\"" << Escaped{name} << "\">" << Escaped{paper.doc.title} << "</a></li>";
+      out << "</ul></body></html>\n";
+      body = index;
+    } else if (auto it = papers.find(std::string(path)); it != papers.end()) {
+      page = it->second.html;
+      body = *page;
+    } else {
+      status = "404 Not Found";
+    }
+  }
+  send_all(fd, "HTTP/1.1 " + status + "\r\nContent-Type: text/html; charset=utf-8\r\nContent-Length: " + std::to_string(body.size()) + "\r\nCache-Control: no-store\r\nConnection: close\r\n\r\n");
+  send_all(fd, body);
+}
+
+int serve(const std::filesystem::path& dir, uint16_t port) {
+  int watch = inotify_init1(IN_CLOEXEC);
+  if (watch < 0 || inotify_add_watch(watch, dir.c_str(), IN_CLOSE_WRITE | IN_MOVED_TO | IN_MOVED_FROM | IN_DELETE) < 0) {
+    fprintf(stderr, "Cannot watch %s\n", dir.c_str());
+    return 1;
+  }
+  int listener = socket(AF_INET, SOCK_STREAM | SOCK_CLOEXEC, 0);
+  int one = 1;
+  setsockopt(listener, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one));
+  sockaddr_in addr = {};
+  addr.sin_family = AF_INET;
+  addr.sin_port = htons(port);
+  addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+  if (listener < 0 || bind(listener, (sockaddr*)&addr, sizeof(addr)) < 0 || listen(listener, 16) < 0) {
+    fprintf(stderr, "Cannot listen on localhost:%u\n", port);
+    return 1;
+  }
+
+  std::map<std::string, Paper> papers;
+  HighlightCache highlights;
+  for (auto& entry : std::filesystem::directory_iterator(dir)) {
+    if (entry.path().extension() == ".fiets") load(papers, highlights, entry.path());
+  }
+  fprintf(stderr, "Serving %zu papers from %s on http://localhost:%u/\n", papers.size(), dir.c_str(), port);
+
+  pollfd fds[2] = { { watch, POLLIN, 0 }, { listener, POLLIN, 0 } };
+  for (;;) {
+    if (poll(fds, 2, -1) < 0) {
+      if (errno == EINTR) continue;
+      break;
+    }
+    if (fds[0].revents & POLLIN) {
+      alignas(inotify_event) char events[16384];
+      ssize_t size = read(watch, events, sizeof(events));
+      for (ssize_t offset = 0; offset < size; ) {
+        auto* event = reinterpret_cast<inotify_event*>(events + offset);
+        std::filesystem::path name = event->len ? event->name : "";
+        if (name.extension() == ".fiets") load(papers, highlights, dir / name);
+        offset += sizeof(inotify_event) + event->len;
+      }
+    }
+    if (fds[1].revents & POLLIN) {
+      int client = accept4(listener, nullptr, nullptr, SOCK_CLOEXEC);
+      if (client >= 0) {
+        // Everything runs on this thread, so a client that connects and then sends nothing (as
+        // browsers' preconnects do) must not hold up re-renders and other requests for long.
+        timeval timeout = { 1, 0 };
+        setsockopt(client, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
+        setsockopt(client, SOL_SOCKET, SO_SNDTIMEO, &timeout, sizeof(timeout));
+        respond(client, papers);
+        close(client);
+      }
+    }
+  }
+  fprintf(stderr, "poll failed\n");
+  return 1;
+}
+#else
+int serve(const std::filesystem::path&, uint16_t) {
+  fprintf(stderr, "--serve needs inotify and is only available on Linux\n");
+  return 1;
+}
+#endif
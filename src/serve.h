@@ -0,0 +1,9 @@
+#pragma once
+
+#include <cstdint>
+#include <filesystem>
+
+// Renders every paper in dir, then serves them on http://localhost:<port>/ and re-renders a paper
+// whenever its file changes. Returns only on error.
+int serve(const std::filesystem::path& dir, uint16_t port);
+
@@ -0,0 +1,44 @@
+#include "sink.h"
+#include "stats.h"
+
+FileSink::FileSink(const std::filesystem::path& path)
+: file(fopen(path.c_str(), "wb"))
+{
+  failed = !file;
+  pos = buffer;
+  end = buffer + sizeof(buffer);
+}
+
+FileSink::~FileSink() {
+  close();
+}
+
+bool FileSink::close() {
+  if (file) {
+    flush();
+    if (fclose(file) != 0) failed = true;
+    file = nullptr;
+  }
+  pos = end = nullptr;
+  return !failed;
+}
+
+void FileSink::flush() {
+  STATS_SCOPE(scope, Phase::Write, size_t(pos - buffer));
+  if (file && pos != buffer && fwrite(buffer, 1, pos - buffer, file) != size_t(pos - buffer)) failed = true;
+  flushed += pos - buffer;
+  pos = buffer;
+}
+
+void FileSink::overflow(std::string_view data) {
+  if (!file) return;
+  flush();
+  if (data.size() < sizeof(buffer)) {
+    memcpy(pos, data.data(), data.size());
+    pos += data.size();
+  } else {
+    STATS_SCOPE(scope, Phase::Write, data.size());
+    if (fwrite(data.data(), 1, data.size(), file) != data.size()) failed = true;
+    flushed += data.size();
+  }
+}
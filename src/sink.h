@@ -0,0 +1,62 @@
+#pragma once
+
+#include <charconv>
+#include <cstdio>
+#include <cstring>
+#include <filesystem>
+#include <string>
+#include <string_view>
+
+// Output stream the renderers append into. Writes land in the sink's buffer; only when it is
+// full does the (virtual) overflow hand the data on.
+struct Sink {
+  virtual ~Sink() = default;
+  void write(std::string_view data) {
+    if (data.size() <= size_t(end - pos)) {
+      if (!data.empty()) memcpy(pos, data.data(), data.size());
+      pos += data.size();
+    } else {
+      overflow(data);
+    }
+  }
+  Sink& operator<<(std::string_view data) { write(data); return *this; }
+  Sink& operator<<(char c) { write(std::string_view(&c, 1)); return *this; }
+  Sink& operator<<(size_t value) {
+    char buffer[24];
+    write(std::string_view(buffer, std::to_chars(buffer, buffer + sizeof(buffer), value).ptr - buffer));
+    return *this;
+  }
+  // Bytes written so far.
+  virtual size_t written() const = 0;
+protected:
+  virtual void overflow(std::string_view data) = 0;
+  char* pos = nullptr;
+  char* end = nullptr;
+};
+
+struct StringSink : Sink {
+  StringSink(std::string& target) : target(target), initial(target.size()) {}
+  size_t written() const override { return target.size() - initial; }
+protected:
+  void overflow(std::string_view data) override { target += data; }
+private:
+  std::string& target;
+  size_t initial;
+};
+
+// Streams into a file through a fixed-size buffer, so memory use does not depend on the output size.
+struct FileSink : Sink {
+  FileSink(const std::filesystem::path& path);
+  ~FileSink();
+  // Flushes and closes the file; returns false if any write failed.
+  bool close();
+  size_t written() const override { return flushed + (pos ? pos - buffer : 0); }
+protected:
+  void overflow(std::string_view data) override;
+private:
+  void flush();
+  FILE* file;
+  bool failed = false;
+  size_t flushed = 0;
+  char buffer[65536];
+};
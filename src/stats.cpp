@@ -0,0 +1,154 @@
+#include "stats.h"
+
+#if FIETS_STATS
+#include "alloc_count.h"
+#include "sink.h"
+#include <chrono>
+#include <memory>
+#include <mutex>
+#include <string_view>
+#include <vector>
+
+bool stats_on = false;
+
+static bool tracing = false;
+
+static constexpr std::string_view phase_names[] = {
+  "read", "parse", "parseText", "addReference", "outline", "highlight", "render",
+  "code", "list", "ordered list", "definition", "table", "text", "references", "toc", "quote",
+  "write",
+};
+static_assert(std::size(phase_names) == size_t(Phase::Count));
+
+static bool is_entry(size_t phase) {
+  return phase >= size_t(Phase::Code) && phase <= size_t(Phase::Quote);
+}
+
+namespace {
+
+struct Totals {
+  size_t calls = 0, bytes = 0, allocations = 0;
+  uint64_t nanoseconds = 0;
+};
+
+struct Event {
+  uint64_t start, duration;
+  size_t bytes, allocations;
+  Phase phase;
+};
+
+// What one thread recorded. It outlives the thread, so workers can be added up after they exit.
+struct ThreadStats {
+  size_t id = 0;
+  Totals totals[size_t(Phase::Count)];
+  std::vector<Event> events;
+  size_t dropped = 0;
+  // Allocations made by the recording itself, which are left out of the counts.
+  size_t own = 0;
+};
+
+// About 40 MB of events per thread.
+constexpr size_t maxEvents = 1 << 20;
+
+std::mutex threadsMutex;
+std::vector<std::shared_ptr<ThreadStats>> threads;
+const std::chrono::steady_clock::time_point epoch = std::chrono::steady_clock::now();
+
+}
+
+static uint64_t now() {
+  return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - epoch).count();
+}
+
+static ThreadStats& this_thread() {
+  thread_local ThreadStats* stats = nullptr;
+  if (!stats) {
+    auto created = std::make_shared<ThreadStats>();
+    std::lock_guard<std::mutex> lock(threadsMutex);
+    created->id = threads.size();
+    threads.push_back(created);
+    stats = created.get();
+  }
+  return *stats;
+}
+
+void StatsScope::begin() {
+  ThreadStats& t = this_thread();
+  allocations = allocation_count() - t.own;
+  start = now();
+}
+
+void StatsScope::end() {
+  uint64_t duration = now() - start;
+  ThreadStats& t = this_thread();
+  size_t allocated = allocation_count() - t.own - allocations;
+  if (sink) bytes = written() - bytes;
+  Totals& totals = t.totals[size_t(phase)];
+  totals.calls++;
+  totals.bytes += bytes;
+  totals.allocations += allocated;
+  totals.nanoseconds += duration;
+  if (!tracing) return;
+  if (t.events.size() == maxEvents) {
+    t.dropped++;
+    return;
+  }
+  size_t before = allocation_count();
+  t.events.push_back(Event{start, duration, bytes, allocated, phase});
+  t.own += allocation_count() - before;
+}
+
+size_t StatsScope::written() const {
+  return sink->written();
+}
+
+void stats_start(bool trace) {
+  tracing = trace;
+  stats_on = true;
+}
+
+void stats_print(FILE* out) {
+  stats_on = false;
+  Totals sum[size_t(Phase::Count)];
+  std::lock_guard<std::mutex> lock(threadsMutex);
+  for (auto& t : threads) {
+    for (size_t n = 0; n < size_t(Phase::Count); n++) {
+      sum[n].calls += t->totals[n].calls;
+      sum[n].bytes += t->totals[n].bytes;
+      sum[n].allocations += t->totals[n].allocations;
+      sum[n].nanoseconds += t->totals[n].nanoseconds;
+    }
+  }
+  fprintf(out, "stats: %.3f ms wall time, %zu threads\n", now() / 1e6, threads.size());
+  fprintf(out, "  %-16s %10s %12s %14s %12s\n", "phase", "calls", "ms", "bytes", "allocations");
+  for (size_t n = 0; n < size_t(Phase::Count); n++) {
+    if (!sum[n].calls) continue;
+    fprintf(out, "  %s%-*s %10zu %12.3f %14zu %12zu\n", is_entry(n) ? "  " : "", is_entry(n) ? 14 : 16, phase_names[n].data(),
+            sum[n].calls, sum[n].nanoseconds / 1e6, sum[n].bytes, sum[n].allocations);
+  }
+  fprintf(out, "  (ms summed over threads, nested phases included; bytes are input up to outline, output from highlight on)\n");
+}
+
+bool stats_write_trace(const std::filesystem::path& file) {
+  stats_on = false;
+  FileSink out(file);
+  char buffer[128];
+  out << "{\"traceEvents\":[\n";
+  bool first = true;
+  size_t dropped = 0;
+  std::lock_guard<std::mutex> lock(threadsMutex);
+  for (auto& t : threads) {
+    dropped += t->dropped;
+    for (auto& e : t->events) {
+      out << (first ? "" : ",\n") << "{\"name\":\"" << phase_names[size_t(e.phase)] << "\",\"cat\":\""
+          << (is_entry(size_t(e.phase)) ? "entry" : "phase") << "\",\"ph\":\"X\",\"pid\":1,\"tid\":" << t->id;
+      out << std::string_view(buffer, snprintf(buffer, sizeof(buffer), ",\"ts\":%.3f,\"dur\":%.3f", e.start / 1e3, e.duration / 1e3));
+      out << ",\"args\":{\"bytes\":" << e.bytes << ",\"allocations\":" << e.allocations << "}}";
+      first = false;
+    }
+  }
+  out << "\n],\"displayTimeUnit\":\"ns\",\"otherData\":{\"dropped\":" << dropped << "}}\n";
+  return out.close();
+}
+
+#endif
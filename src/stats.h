@@ -0,0 +1,62 @@
+#pragma once
+
+// Where a run spends its time: wall time, calls, bytes and heap allocations per phase, and per kind
+// of entry rendered, summed over all threads; optionally also every call as a Chrome trace event
+// (chrome://tracing or ui.perfetto.dev). Phases nest, so a phase's figures include those of the
+// phases it calls. Only built with -DFIETS_STATS=1 (toolsets/linux-stats.toolset); otherwise
+// STATS_SCOPE and STATS_BYTES compile to nothing.
+#if FIETS_STATS
+
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <filesystem>
+
+struct Sink;
+
+enum class Phase : uint8_t {
+  Read, Parse, ParseText, AddReference, Outline, Highlight, Render,
+  // Rendering one DocumentEntry, by alternative.
+  Code, List, OrderedList, IdentifierDefinition, Table, Text, References, TOC, Quote,
+  Write,
+  Count
+};
+
+// Set by stats_start(); until then scopes record nothing.
+extern bool stats_on;
+
+// Records one call to a phase, from construction to destruction. Bytes are the input handled, or
+// with a sink what was written into it meanwhile.
+struct StatsScope {
+  StatsScope(Phase phase, size_t bytes = 0) : bytes(bytes), phase(phase), active(stats_on) { if (active) begin(); }
+  StatsScope(Phase phase, const Sink& out) : StatsScope(phase) { sink = &out; if (active) bytes = written(); }
+  ~StatsScope() { if (active) end(); }
+  StatsScope(const StatsScope&) = delete;
+  StatsScope& operator=(const StatsScope&) = delete;
+  size_t bytes;
+private:
+  void begin();
+  void end();
+  size_t written() const;
+  Phase phase;
+  bool active;
+  const Sink* sink = nullptr;
+  uint64_t start = 0;
+  size_t allocations = 0;
+};
+
+// Starts recording. With trace, every call is kept (up to a limit per thread) for stats_write_trace().
+void stats_start(bool trace);
+// Stop recording and report what was recorded; call them once the other threads are done.
+void stats_print(FILE* out);
+bool stats_write_trace(const std::filesystem::path& file);
+
+#define STATS_SCOPE(name, ...) StatsScope name(__VA_ARGS__)
+#define STATS_BYTES(name, n) (name.bytes += (n))
+
+#else
+
+#define STATS_SCOPE(name, ...)
+#define STATS_BYTES(name, n) ((void)0)
+
+#endif
@@ -0,0 +1,27 @@
+#!/bin/sh
+# Profile-guided build. Builds an instrumented fiets, trains it by rendering and benchmarking
+# papers/, merges the profile into pgo/fiets.profdata and rebuilds with linux-pgo.toolset.
+# Benchmarks of the plain release build and the PGO build are left in pgo/ for comparison.
+#
+# BUILD is the command that builds with the toolset given as its last argument, FIETS the
+# binary it produces.
+set -e
+cd "$(dirname "$0")/.."
+BUILD=${BUILD:-"evoke -t"}
+FIETS=${FIETS:-bin/fiets}
+PROFDATA=${PROFDATA:-llvm-profdata-9}
+
+rm -rf pgo
+mkdir -p pgo/raw pgo/out
+
+$BUILD toolsets/linux.toolset
+$FIETS --bench papers > pgo/bench-release.txt
+
+$BUILD toolsets/linux-pgo-generate.toolset
+LLVM_PROFILE_FILE=pgo/raw/%p.profraw $FIETS --batch --no-cache pgo/out papers
+LLVM_PROFILE_FILE=pgo/raw/%p.profraw $FIETS --bench --synthetic-size 1 papers > /dev/null
+$PROFDATA merge -o pgo/fiets.profdata pgo/raw/*.profraw
+
+$BUILD toolsets/linux-pgo.toolset
+$FIETS --bench papers > pgo/bench-pgo.txt
+paste -d '\n' pgo/bench-release.txt pgo/bench-pgo.txt